@@ -3,4 +3,335 @@
  *
  * Created: 20/06/2018 01:23:45
  *  Author: Jake Bird
- */
\ No newline at end of file
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "StandardTypes.h"
+#include "Std_IO_Macros.h"
+#include "RS232.h"
+#include "DCell.h"
+#include "ModbusCrc.h"
+
+// Modbus master for the DCell. Requests are queued by DCellQueue and sent one at a time;
+// the UART2 receive ISR collects each reply (see DCellRxByte) and the tick ISR times it out
+// (see DCellTick). Either way the transaction is finished inside an ISR, the next request
+// is started straight away, and the reply waits in a slot for DCellTakeReply.
+// The queues are indexed by free-running counters, so head - tail is the number in use.
+//
+// Replies are delimited the Modbus RTU way, by the silence on the line rather than by their
+// function code. Timer3 is restarted by every byte received: compare A marks the t1.5 gap,
+// after which another byte spoils the frame, and compare B marks the t3.5 gap that ends it.
+// A reply that is spoilt, too short or fails its CRC is sent for again (DCELL_RETRIES).
+//
+// When DCell is streaming (see DCellStream) frames that look like a streamed reading are kept aside
+// as the latest sample instead, unless a read is in progress, whose reply could not be told apart.
+
+char dcellQueueFrame[DCELL_QUEUE_SIZE][DCELL_REQUEST_SIZE]; // requests waiting to be sent
+byte dcellQueueLength[DCELL_QUEUE_SIZE];
+byte dcellQueueTag[DCELL_QUEUE_SIZE];
+volatile byte dcellQueueHead = 0;
+volatile byte dcellQueueTail = 0;
+
+char dcellDoneFrame[DCELL_QUEUE_SIZE][DCELL_FRAME_SIZE]; // replies waiting to be taken
+byte dcellDoneLength[DCELL_QUEUE_SIZE];
+byte dcellDoneTag[DCELL_QUEUE_SIZE];
+byte dcellDoneResult[DCELL_QUEUE_SIZE];
+volatile byte dcellDoneHead = 0;
+volatile byte dcellDoneTail = 0;
+
+volatile byte dcellBusy = 0; // a request has been sent and we are waiting for its reply
+volatile byte dcellTag = 0; // tag of the request in progress
+volatile word dcellTimer = 0; // ticks left before the request in progress times out
+volatile byte dcellTxDone = 0; // the request in progress has been sent, and the timeout is now for its reply
+volatile byte dcellRetries = 0; // times the request in progress can still be sent again
+
+volatile word dcellRxCrc = MODBUS_CRC_INIT; // running CRC of the reply being received
+volatile byte dcellRxCount = 0; // bytes of the reply received so far
+volatile byte dcellRxError = 0; // UART errors seen during the reply, or a broken frame
+volatile byte dcellRxGap = 0; // t1.5 has passed since the last byte
+char* volatile dcellRxFrame; // where the frame being received is going, picked by its first byte
+
+volatile byte dcellStreaming = 0; // DCell is sending readings on its own
+char dcellStreamFrame[DCELL_STREAM_SIZE]; // streamed frame received while no request is in progress
+char dcellStreamValue[4]; // force register from the latest streamed reading
+volatile word dcellStreamAge = 0xFFFF; // ticks since the latest streamed reading
+
+// Gives the baud rate for an MD_BAUD code, or 0 if it is not one we know
+dword DCellBaudRate(byte code)
+{
+	switch (code)
+	{
+	case 0:
+		return 2400;
+	case 1:
+		return 4800;
+	case 2:
+		return 9600;
+	case 3:
+		return 19200;
+	case 4:
+		return 38400;
+	case 5:
+		return 57600;
+	case 6:
+		return 115200;
+	case 7:
+		return 230400;
+	}
+	return 0;
+}
+
+// Sets the RTU gaps for the baud rate UART2 is running at; call whenever it is changed
+// Above 19200 baud the fixed times from the Modbus spec are used
+void DCellRtuTiming(dword baudrate)
+{
+	word t15, t35;
+	if (baudrate > 19200)
+	{
+		t15 = DCELL_T3_COUNT(750);
+		t35 = DCELL_T3_COUNT(1750);
+	}
+	else
+	{
+		t15 = DCELL_T3_COUNT(16500000UL / baudrate); // 1.5 characters of 11 bits
+		t35 = DCELL_T3_COUNT(38500000UL / baudrate); // 3.5 characters of 11 bits
+	}
+	byte sreg = SREG;
+	cli();
+	TIMSK3 = 0;
+	TCCR3A = 0;
+	TCCR3B = DCELL_T3_PRESCALE;
+	OCR3A = t15;
+	OCR3B = t35;
+	SREG = sreg;
+}
+
+// Restarts the RTU gap timer; called as each byte arrives
+static void DCellRtuRestart(void)
+{
+	TCNT3 = 0;
+	TIFR3 = (1 << OCF3A) | (1 << OCF3B);
+	TIMSK3 = (1 << OCIE3A) | (1 << OCIE3B);
+}
+
+// Sends the request at the tail of the queue; it stays there until it is finished so it can be sent again
+// Only called with interrupts disabled
+static void DCellSend(void)
+{
+	byte slot = dcellQueueTail & DCELL_QUEUE_MASK;
+	dcellRxCrc = MODBUS_CRC_INIT;
+	dcellRxCount = 0;
+	dcellRxError = 0;
+	dcellRxGap = 0;
+	dcellTag = dcellQueueTag[slot];
+	dcellTimer = DCELL_TIMEOUT; // covers sending as well, in case the transmitter never says it is done
+	dcellTxDone = 0;
+	dcellBusy = 1;
+	uart2_putbytes(dcellQueueFrame[slot], dcellQueueLength[slot]);
+}
+
+// Sends the oldest queued request if the line is free and there is somewhere to put its reply
+// Only called with interrupts disabled
+static void DCellStartNext(void)
+{
+	if (dcellBusy || dcellQueueHead == dcellQueueTail || (byte)(dcellDoneHead - dcellDoneTail) >= DCELL_QUEUE_SIZE)
+		return;
+	if (dcellStreaming && dcellRxCount)
+		return; // a streamed reading is arriving; the end of its frame starts us again
+	dcellRetries = DCELL_RETRIES;
+	DCellSend();
+}
+
+// Hands the request in progress over to DCellTakeReply and moves on to the next one
+// Only called with interrupts disabled
+static void DCellFinish(byte result)
+{
+	if (result != dcResultOk && dcellRetries)
+	{
+		dcellRetries--;
+		DCellSend();
+		return;
+	}
+	byte slot = dcellDoneHead & DCELL_QUEUE_MASK;
+	dcellDoneLength[slot] = dcellRxCount;
+	dcellDoneTag[slot] = dcellTag;
+	dcellDoneResult[slot] = result;
+	dcellDoneHead++;
+	dcellQueueTail++;
+	dcellBusy = 0;
+	DCellStartNext();
+}
+
+// Queues a complete packet (checksum included) to be sent to DCell; safe to call from an ISR
+// Returns 0 if the queue is full or the packet is too long
+byte DCellQueue(const char* frame, byte length, byte tag)
+{
+	byte queued = 0;
+	if (length > DCELL_REQUEST_SIZE)
+		return 0;
+	byte sreg = SREG;
+	cli();
+	if ((byte)(dcellQueueHead - dcellQueueTail) < DCELL_QUEUE_SIZE)
+	{
+		byte slot = dcellQueueHead & DCELL_QUEUE_MASK;
+		for (byte i = 0; i < length; i++)
+			dcellQueueFrame[slot][i] = frame[i];
+		dcellQueueLength[slot] = length;
+		dcellQueueTag[slot] = tag;
+		dcellQueueHead++;
+		DCellStartNext();
+		queued = 1;
+	}
+	SREG = sreg;
+	return queued;
+}
+
+// Takes the oldest finished transaction, copying its reply into frame
+// Returns its result, or dcResultNone if nothing has finished yet
+byte DCellTakeReply(char* frame, byte* length, byte* tag)
+{
+	if (dcellDoneHead == dcellDoneTail)
+		return dcResultNone;
+	byte slot = dcellDoneTail & DCELL_QUEUE_MASK;
+	byte result = dcellDoneResult[slot];
+	byte count = dcellDoneLength[slot];
+	if (count > DCELL_FRAME_SIZE)
+		count = DCELL_FRAME_SIZE;
+	for (byte i = 0; i < count; i++)
+		frame[i] = dcellDoneFrame[slot][i];
+	*length = count;
+	*tag = dcellDoneTag[slot];
+	byte sreg = SREG;
+	cli();
+	if (dcellDoneHead != dcellDoneTail) // DCellFlush may have taken it already
+		dcellDoneTail++;
+	DCellStartNext(); // in case it was waiting for a free slot
+	SREG = sreg;
+	return result;
+}
+
+// Called from the UART2 receive ISR with each byte; the reply is stored and its CRC worked out
+// as it arrives, so the transaction is over as soon as the line has been quiet for t3.5
+// Always takes the byte, so nothing from DCell is left in the UART2 receive buffer
+byte DCellRxByte(byte data, byte error)
+{
+	DCellRtuRestart();
+	if (!dcellBusy && !dcellStreaming)
+		return 1; // not waiting for anything, so it can only be noise
+	if (dcellRxGap && dcellRxCount)
+		dcellRxError = 1; // a gap inside the frame
+	dcellRxGap = 0;
+	if (!dcellRxCount)
+		dcellRxFrame = dcellBusy ? dcellDoneFrame[dcellDoneHead & DCELL_QUEUE_MASK] : dcellStreamFrame;
+	if (dcellRxCount < (dcellRxFrame == dcellStreamFrame ? DCELL_STREAM_SIZE : DCELL_FRAME_SIZE))
+		dcellRxFrame[dcellRxCount++] = data;
+	else
+		dcellRxError = 1;
+	dcellRxCrc = ModbusCrcUpdate(dcellRxCrc, data);
+	dcellRxError |= error;
+	return 1;
+}
+
+// t1.5 has passed since the last byte
+ISR(ISR_DCellT15)
+{
+	dcellRxGap = 1;
+	TIMSK3 &= ~(1 << OCIE3A);
+}
+
+// t3.5 has passed since the last byte, so the frame is complete
+ISR(ISR_DCellT35)
+{
+	TIMSK3 = 0;
+	if (!dcellRxCount)
+		return;
+	byte good = (dcellRxCount >= DCELL_FRAME_MIN && dcellRxCrc == MODBUS_CRC_RESIDUE && !dcellRxError);
+	if (dcellStreaming && good && dcellRxCount == DCELL_STREAM_SIZE && dcellRxFrame[1] == 3 && dcellRxFrame[2] == 4
+		&& (!dcellBusy || dcellQueueFrame[dcellQueueTail & DCELL_QUEUE_MASK][1] != 3))
+	{
+		for (byte i = 0; i < 4; i++)
+			dcellStreamValue[i] = dcellRxFrame[3 + i];
+		dcellStreamAge = 0;
+	}
+	else if (dcellBusy)
+	{
+		DCellFinish(good ? dcResultOk : dcResultBadReply);
+		return;
+	}
+	dcellRxCrc = MODBUS_CRC_INIT; // ready for the next frame, still waiting for the reply if busy
+	dcellRxCount = 0;
+	dcellRxError = 0;
+	DCellStartNext();
+}
+
+// Called from the UART2 transmit complete ISR; the reply timeout starts from here
+void DCellTxDone(void)
+{
+	if (dcellBusy && !dcellTxDone)
+	{
+		dcellTxDone = 1;
+		dcellTimer = DCELL_TIMEOUT;
+	}
+}
+
+// Called from the tick ISR to time out a request that has not been answered
+void DCellTick(void)
+{
+	if (dcellStreamAge < 0xFFFF)
+		dcellStreamAge++;
+	if (dcellBusy && --dcellTimer == 0)
+		DCellFinish(dcResultTimeout);
+}
+
+// Starts or stops keeping streamed readings; turn it on before DCell starts streaming
+// and off once it has stopped
+void DCellStream(byte on)
+{
+	byte sreg = SREG;
+	cli();
+	dcellStreaming = on;
+	dcellStreamAge = 0xFFFF;
+	SREG = sreg;
+}
+
+// Copies the force register of the latest streamed reading into value
+// Returns 0 if nothing has been streamed for DCELL_TIMEOUT ticks
+byte DCellLatestSample(char* value)
+{
+	byte fresh = 0;
+	byte sreg = SREG;
+	cli();
+	if (dcellStreamAge < DCELL_TIMEOUT)
+	{
+		for (byte i = 0; i < 4; i++)
+			value[i] = dcellStreamValue[i];
+		fresh = 1;
+	}
+	SREG = sreg;
+	return fresh;
+}
+
+// Drops every queued request and every reply not yet taken. The request in progress is left to
+// finish, or its reply could be taken for the next one, but is tagged dcTagIgnore (dcTagSampleIgnore
+// if it was a sample) so nothing waits for it. Returns 1 if that was a sample, whose reply is still
+// to be taken; safe to call from an ISR
+byte DCellFlush(void)
+{
+	byte sample = 0;
+	byte sreg = SREG;
+	cli();
+	if (dcellBusy)
+	{
+		sample = (dcellTag == dcTagSample || dcellTag == dcTagSampleIgnore);
+		dcellTag = sample ? dcTagSampleIgnore : dcTagIgnore;
+		dcellQueueTag[dcellQueueTail & DCELL_QUEUE_MASK] = dcellTag; // in case it is sent again
+		dcellQueueHead = dcellQueueTail + 1;
+	}
+	else
+		dcellQueueHead = dcellQueueTail;
+	dcellDoneTail = dcellDoneHead;
+	SREG = sreg;
+	return sample;
+}
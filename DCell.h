@@ -8,6 +8,8 @@
 #ifndef DCELL_H_
 #define DCELL_H_
 
+#include "StandardTypes.h"
+
 #define FLAG_TEMPUR 4
 #define FLAG_TEMPOR 8
 #define FLAG_ECOMUR 16
@@ -149,4 +151,73 @@
 #define MD_CTO3 246
 #define MD_CTO4 248
 #define MD_CTO5 250
+
+#define DCELL_TIMEOUT 100 // ticks to wait for a reply
+#define DCELL_RETRIES 2 // times a request is sent again after a bad reply or no reply
+#define DCELL_QUEUE_SIZE 8 // requests that can be waiting at once, must be a power of 2
+#define DCELL_QUEUE_MASK (DCELL_QUEUE_SIZE - 1)
+#define DCELL_FRAME_SIZE 48 // longest reply kept, anything longer is a bad reply
+#define DCELL_REQUEST_SIZE 16 // longest request that can be queued
+#define DCELL_FRAME_MIN 4 // station, function code and CRC
+
+// Timer3 times the RTU gaps between bytes from DCell, counting at F_CPU / 8
+#define ISR_DCellT15		TIMER3_COMPA_vect
+#define ISR_DCellT35		TIMER3_COMPB_vect
+#define DCELL_T3_PRESCALE ((0 << CS32) | (1 << CS31) | (0 << CS30))
+#define DCELL_T3_COUNT(us) ((word)((F_CPU / 8000UL) * (us) / 1000UL))
+
+// Tags say who asked for a transaction, so its reply can be dealt with properly
+#define dcTagCommand 0
+#define dcTagSample 1
+#define dcTagIgnore 2
+#define dcTagCheck 3 // a failure is left for the caller to deal with, rather than an EStop
+#define dcTagSampleIgnore 4 // a dcTagSample DCellFlush dropped while it was on the line
+
+// MD_BAUD codes go from 0 (2400) up to 7 (230400)
+#define DCELL_BAUD_DEFAULT 5 // 57600, as set up in main
+#define DCELL_UBRR_NONE 0xFFFF
+
+// UART2 runs at double speed (U2X), so it gets F_CPU / (8 * (UBRR + 1)); DCELL_UBRR rounds to the
+// nearest UBRR and DCELL_BAUD_ERROR gives how far the rate that gets is from rate, in thousandths
+#define DCELL_UBRR(rate) ((word)((F_CPU + 4UL * (rate)) / (8UL * (rate)) - 1))
+#define DCELL_BAUD_ACTUAL(rate) (F_CPU / (8UL * (DCELL_UBRR(rate) + 1UL)))
+#define DCELL_BAUD_ERROR(rate) ((DCELL_BAUD_ACTUAL(rate) > (rate) ? DCELL_BAUD_ACTUAL(rate) - (rate) : (rate) - DCELL_BAUD_ACTUAL(rate)) * 1000UL / (rate))
+
+// With U2X and 8N1 frames the receiver copes with the other end being 96.0% to 103.9% of its own
+// rate (datasheet, asynchronous receiver error tolerance); 2.5% is used, leaving the rest for DCell's
+// own clock and the line. At 16MHz every code up to 6 (115200, +2.1%) passes and 7 (230400, -3.5%)
+// does not, so 115200 is the ceiling there; test/DCellBaudTest prints the rates for an F_CPU
+#define DCELL_BAUD_ERROR_MAX 25
+
+// Streaming: with MD_OPCL set to DCELL_OPCL_STREAM, DCell sends the force on its own at the MD_RATE
+// it has been given, each reading framed like the reply to a read of MD_CRAW
+#define DCELL_OPCL_STREAM 1
+#define DCELL_STREAM_SIZE 9 // station, function code, byte count, 4 bytes of force and CRC
+
+// Registers that can be read along with the force in each sample; the sample frame
+// reads every register from the lowest selected to MD_CRAW in one request
+#define dcFieldStat 1
+#define dcFieldTemp 2
+#define dcFieldFlag 4
+#define dcFieldAll (dcFieldStat | dcFieldTemp | dcFieldFlag)
+
+#define DCELL_STAT_OVERRANGE (STAT_CRAWUR | STAT_CRAWOR | STAT_SYSUR | STAT_SYSOR)
+#define DCELL_STAT_STALE STAT_OLDVAL
+
+#define dcResultNone 0
+#define dcResultOk 1
+#define dcResultBadReply 2
+#define dcResultTimeout 3
+
+dword DCellBaudRate(byte code);
+void DCellRtuTiming(dword baudrate);
+byte DCellQueue(const char* frame, byte length, byte tag);
+byte DCellTakeReply(char* frame, byte* length, byte* tag);
+byte DCellRxByte(byte data, byte error);
+void DCellTxDone(void);
+void DCellTick(void);
+void DCellStream(byte on);
+byte DCellLatestSample(char* value);
+byte DCellFlush(void);
+
 #endif /* DCELL_H_ */
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+ * DCellFloat.c
+ *
+ * Created: 17/10/2026 20:12:31
+ */
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "DCellFloat.h"
+
+byte floatFlags = 0; // set by DCellFloatToFixed
+
+// Converts a float register received from DCell to a signed fixed point number with fracBits fractional bits
+// Integer only, as we need to act on the force as quickly as possible; floatFlags says if the number
+// had to be saturated (too big, infinite or not a number) or came out as 0 (too small)
+long DCellFloatToFixed(const char* value, byte fracBits)
+{
+	// value     [2]      [3]      [0]      [1]
+	// float  SEEEEEEE EMMMMMMM MMMMMMMM MMMMMMMM
+	byte exponent = ((byte)value[2] << 1) | ((byte)value[3] >> 7);
+	dword mantissa = ((dword)((byte)value[3] | 0x80) << 16) | ((word)(byte)value[0] << 8) | (byte)value[1]; // with the hidden 1 put back
+	int shift = exponent - 150 + fracBits; // the number is mantissa * 2^shift
+	long number;
+	floatFlags = 0;
+	if (exponent == 0)
+		number = 0; // zero, or too small to matter
+	else if (exponent == 255 || shift > 7) // mantissa is 24 bits, so any more would not fit in 31
+	{
+		number = 0x7FFFFFFF;
+		floatFlags = FLOAT_SATURATED;
+	}
+	else if (shift >= 0)
+		number = mantissa << shift;
+	else if (shift > -25)
+		number = (mantissa + (1UL << (-shift - 1))) >> -shift; // rounded to nearest
+	else
+		number = 0;
+	if (!number && exponent)
+		floatFlags = FLOAT_UNDERFLOW;
+	if (value[2] & 0x80) // if the number is negative
+		number = -number;
+	return number;
+}
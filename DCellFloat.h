@@ -0,0 +1,23 @@
+/*
+ * DCellFloat.h
+ *
+ * Created: 17/10/2026 20:10:04
+ */
+
+#ifndef DCELLFLOAT_H_
+#define DCELLFLOAT_H_
+
+#include "StandardTypes.h"
+
+// DCell gives its readings as IEEE-754 floats, in two registers with the low word first, each
+// register high byte first, so the sign and exponent are in value[2]; they are turned into fixed
+// point with integer sums only, as there is no FPU to spare
+
+#define FLOAT_SATURATED 1 // too big, infinite or not a number
+#define FLOAT_UNDERFLOW 2 // not 0, but too small to show
+
+extern byte floatFlags;
+
+long DCellFloatToFixed(const char* value, byte fracBits);
+
+#endif /* DCELLFLOAT_H_ */
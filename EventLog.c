@@ -0,0 +1,76 @@
+/*
+ * EventLog.c
+ *
+ * Created: 17/10/2026 14:05:51
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "StandardTypes.h"
+#include "EventLog.h"
+
+byte eventId[EVENT_LOG_SIZE];
+dword eventTime[EVENT_LOG_SIZE];
+word eventPayload[EVENT_LOG_SIZE];
+volatile byte eventHead = 0;
+volatile byte eventTail = 0;
+volatile word eventDropped = 0; // events lost because the log was full
+
+// Logs an event; safe to call from an ISR, and never waits
+// If the log is full the event is counted as dropped instead
+void EventLog(byte id, dword time, word payload)
+{
+	byte sreg = SREG;
+	cli();
+	if ((byte)(eventHead - eventTail) < EVENT_LOG_SIZE)
+	{
+		byte slot = eventHead & EVENT_LOG_MASK;
+		eventId[slot] = id;
+		eventTime[slot] = time;
+		eventPayload[slot] = payload;
+		eventHead++;
+	}
+	else if (eventDropped < 0xFFFF)
+		eventDropped++;
+	SREG = sreg;
+}
+
+// Takes the oldest event off the log; returns 0 if there is none
+byte EventLogTake(byte* id, dword* time, word* payload)
+{
+	if (eventHead == eventTail)
+		return 0;
+	byte slot = eventTail & EVENT_LOG_MASK;
+	*id = eventId[slot];
+	*time = eventTime[slot];
+	*payload = eventPayload[slot];
+	eventTail++;
+	return 1;
+}
+
+// Gives the number of events dropped since it was last asked, and starts counting again
+word EventLogTakeDropped(void)
+{
+	byte sreg = SREG;
+	cli();
+	word dropped = eventDropped;
+	eventDropped = 0;
+	SREG = sreg;
+	return dropped;
+}
+
+// Gives the text sent to the robot for an event
+const char* EventLogText(byte id)
+{
+	switch (id)
+	{
+	case evEStopThrown:
+		return "EStop thrown";
+	case evIsrEStop:
+		return "ISR Estop thrown";
+	case evDCellSlowSample:
+		return "DCell slow sample";
+	}
+	return "Unknown event";
+}
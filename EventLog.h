@@ -0,0 +1,26 @@
+/*
+ * EventLog.h
+ *
+ * Created: 17/10/2026 14:02:17
+ */
+
+#ifndef EVENTLOG_H_
+#define EVENTLOG_H_
+
+#include "StandardTypes.h"
+
+// Events are logged in constant time, so ISRs can log without ever waiting on the robot link;
+// the main loop takes them off again when there is room to send them
+#define EVENT_LOG_SIZE 16 // events that can wait to be sent, must be a power of 2
+#define EVENT_LOG_MASK (EVENT_LOG_SIZE - 1)
+
+#define evEStopThrown 0 // payload is the error number << 8 | error parameter
+#define evIsrEStop 1
+#define evDCellSlowSample 2 // payload is the number of samples waiting
+
+void EventLog(byte id, dword time, word payload);
+byte EventLogTake(byte* id, dword* time, word* payload);
+word EventLogTakeDropped(void);
+const char* EventLogText(byte id);
+
+#endif /* EVENTLOG_H_ */
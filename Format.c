@@ -0,0 +1,95 @@
+/*
+ * Format.c
+ *
+ * Created: 17/10/2026 19:24:02
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "StandardTypes.h"
+#include "Format.h"
+
+// "00" to "99", 200 bytes of flash
+static const char formatPairs[200] PROGMEM =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+// The powers of ten above the last four digits
+static const dword formatPowers[6] PROGMEM = { 1000000000, 100000000, 10000000, 1000000, 100000, 10000 };
+
+// Writes value (below 10000) to out as four digits, with leading zeros
+static void FormatFour(char* out, word value)
+{
+	byte high = ((dword)value * 5243) >> 19; // value / 100, exact below 43699
+	byte low = value - high * 100;
+	out[0] = pgm_read_byte(&formatPairs[high * 2]);
+	out[1] = pgm_read_byte(&formatPairs[high * 2 + 1]);
+	out[2] = pgm_read_byte(&formatPairs[low * 2]);
+	out[3] = pgm_read_byte(&formatPairs[low * 2 + 1]);
+}
+
+// Writes value to out in decimal, without leading zeros
+byte FormatUnsigned(char* out, dword value)
+{
+	char four[4];
+	byte length = 0;
+	byte i = 0;
+	if (value >= 10000)
+	{
+		while (value < pgm_read_dword(&formatPowers[i]))
+			i++;
+		for (; i < 6; i++)
+		{
+			dword power = pgm_read_dword(&formatPowers[i]);
+			char digit = '0';
+			while (value >= power)
+			{
+				value -= power;
+				digit++;
+			}
+			out[length++] = digit;
+		}
+		FormatFour(&out[length], value);
+		length += 4;
+	}
+	else
+	{
+		FormatFour(four, value);
+		i = value >= 1000 ? 0 : value >= 100 ? 1 : value >= 10 ? 2 : 3;
+		for (; i < 4; i++)
+			out[length++] = four[i];
+	}
+	out[length] = 0;
+	return length;
+}
+
+// Writes value to out in decimal, with a minus sign if it is negative
+byte FormatLong(char* out, long value)
+{
+	if (value < 0)
+	{
+		*out = '-';
+		return FormatUnsigned(out + 1, -(dword)value) + 1;
+	}
+	return FormatUnsigned(out, value);
+}
+
+// Writes the last digits (1 to 4) of value (below 10000) to out, with leading zeros; for fractions
+byte FormatDigits(char* out, word value, byte digits)
+{
+	char four[4];
+	FormatFour(four, value);
+	for (byte i = 0; i < digits; i++)
+		out[i] = four[4 - digits + i];
+	out[digits] = 0;
+	return digits;
+}
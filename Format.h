@@ -0,0 +1,22 @@
+/*
+ * Format.h
+ *
+ * Created: 17/10/2026 19:20:36
+ */
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include "StandardTypes.h"
+
+// Decimal formatting for the lines sent to the robot and Cnc, in place of itoa/ltoa, which divide
+// by 10 for every digit; these take the digits above the last four off by subtracting powers of
+// ten, and the last four two at a time from a table of digit pairs. All write a null after the
+// digits and return how many they wrote, so the caller can carry on from there without strlen
+#define FORMAT_LONG_MAX 11 // longest text FormatLong writes, with the sign but not the null
+
+byte FormatUnsigned(char* out, dword value);
+byte FormatLong(char* out, long value);
+byte FormatDigits(char* out, word value, byte digits);
+
+#endif /* FORMAT_H_ */
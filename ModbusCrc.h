@@ -0,0 +1,31 @@
+/*
+ * ModbusCrc.h
+ *
+ * Created: 17/10/2026 09:10:03
+ */
+
+#ifndef MODBUSCRC_H_
+#define MODBUSCRC_H_
+
+#include "StandardTypes.h"
+
+// CRC-16/MODBUS engines, pick one at build time with -DMODBUS_CRC_MODE=...
+//   MODBUS_CRC_TABLE   - 256 entry table in flash, fastest (512 bytes of flash)
+//   MODBUS_CRC_NIBBLE  - 16 entry table in flash, two lookups per byte (32 bytes of flash)
+//   MODBUS_CRC_BITWISE - original shift and xor loop, no table
+#define MODBUS_CRC_BITWISE 0
+#define MODBUS_CRC_NIBBLE 1
+#define MODBUS_CRC_TABLE 2
+
+#ifndef MODBUS_CRC_MODE
+	#define MODBUS_CRC_MODE MODBUS_CRC_TABLE
+#endif
+
+#define MODBUS_CRC_POLY 0xA001
+#define MODBUS_CRC_INIT 0xFFFF
+#define MODBUS_CRC_RESIDUE 0x0000
+
+word ModbusCrcUpdate(word crc, byte data);
+word ModbusCrc(const char* data, byte length);
+
+#endif /* MODBUSCRC_H_ */
@@ -0,0 +1,116 @@
+/*
+ * ParamStore.c
+ *
+ * Created: 17/10/2026 17:14:02
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <string.h>
+
+#include "StandardTypes.h"
+#include "ModbusCrc.h"
+#include "ParamStore.h"
+
+// Reads the record at address into data; returns 0, leaving data alone, if there is no valid
+// record of this version and length there
+byte ParamStoreLoad(word address, void* data, byte length, byte version)
+{
+	byte* eeprom = (byte*)address;
+	if (eeprom_read_byte(eeprom) != version || eeprom_read_byte(eeprom + 1) != length)
+		return 0;
+	word crc = ModbusCrcUpdate(ModbusCrcUpdate(MODBUS_CRC_INIT, version), length);
+	for (byte i = 0; i < length; i++)
+		crc = ModbusCrcUpdate(crc, eeprom_read_byte(eeprom + 2 + i));
+	// the CRC is stored low byte first, so running it through as well leaves the residue
+	crc = ModbusCrcUpdate(crc, eeprom_read_byte(eeprom + 2 + length));
+	crc = ModbusCrcUpdate(crc, eeprom_read_byte(eeprom + 3 + length));
+	if (crc != MODBUS_CRC_RESIDUE)
+		return 0;
+	eeprom_read_block(data, eeprom + 2, length);
+	return 1;
+}
+
+// Writes data as the record at address; bytes that have not changed are not written again
+void ParamStoreSave(word address, const void* data, byte length, byte version)
+{
+	byte* eeprom = (byte*)address;
+	word crc = ModbusCrcUpdate(ModbusCrcUpdate(MODBUS_CRC_INIT, version), length);
+	for (byte i = 0; i < length; i++)
+		crc = ModbusCrcUpdate(crc, ((const byte*)data)[i]);
+	// the version goes last, so a write cut short leaves a record that fails its CRC
+	eeprom_update_byte(eeprom, PARAM_STORE_BLANK);
+	eeprom_update_byte(eeprom + 1, length);
+	eeprom_update_block(data, eeprom + 2, length);
+	eeprom_update_byte(eeprom + 2 + length, crc & 0xFF);
+	eeprom_update_byte(eeprom + 3 + length, crc >> 8);
+	eeprom_update_byte(eeprom, version);
+}
+
+// Marks the record at address as not there, with a single byte write
+void ParamStoreErase(word address)
+{
+	eeprom_update_byte((byte*)address, PARAM_STORE_BLANK);
+}
+
+// Finds the slot of a ring holding the newest valid record, loading it into buffer
+// Returns slots if none of them does
+byte ParamRingNewest(word address, byte slots, byte* buffer, byte length, byte version)
+{
+	byte newest = slots;
+	byte newestSequence = 0;
+	byte record[PARAM_RING_MAX + 1];
+	for (byte i = 0; i < slots; i++)
+	{
+		if (!ParamStoreLoad(address + i * PARAM_RING_SLOT(length), record, length + 1, version))
+			continue;
+		// sequence numbers wrap, so newer means less than half way round ahead
+		if (newest == slots || (signed char)(record[0] - newestSequence) > 0)
+		{
+			newest = i;
+			newestSequence = record[0];
+			memcpy(buffer, record, length + 1);
+		}
+	}
+	return newest;
+}
+
+// Reads the newest record in the ring of slots at address into data; returns 0, leaving data
+// alone, if none of them holds a valid record of this version and length
+byte ParamRingLoad(word address, byte slots, void* data, byte length, byte version)
+{
+	byte record[PARAM_RING_MAX + 1];
+	if (length > PARAM_RING_MAX || ParamRingNewest(address, slots, record, length, version) == slots)
+		return 0;
+	memcpy(data, &record[1], length);
+	return 1;
+}
+
+// Writes data to the slot after the newest in the ring at address; the newest is left alone until
+// the new one is complete, so a write cut short loses nothing
+void ParamRingSave(word address, byte slots, const void* data, byte length, byte version)
+{
+	byte record[PARAM_RING_MAX + 1];
+	if (length > PARAM_RING_MAX)
+		return;
+	byte slot = ParamRingNewest(address, slots, record, length, version);
+	if (slot == slots)
+	{
+		slot = 0;
+		record[0] = 0;
+	}
+	else
+	{
+		slot = (slot + 1) % slots;
+		record[0]++;
+	}
+	memcpy(&record[1], data, length);
+	ParamStoreSave(address + slot * PARAM_RING_SLOT(length), record, length + 1, version);
+}
+
+// Marks every slot of the ring at address as not there
+void ParamRingErase(word address, byte slots, byte length)
+{
+	for (byte i = 0; i < slots; i++)
+		ParamStoreErase(address + i * PARAM_RING_SLOT(length));
+}
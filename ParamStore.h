@@ -0,0 +1,36 @@
+/*
+ * ParamStore.h
+ *
+ * Created: 17/10/2026 17:10:36
+ */
+
+#ifndef PARAMSTORE_H_
+#define PARAMSTORE_H_
+
+#include "StandardTypes.h"
+
+// Records of parameters kept in EEPROM; each is stored as
+//   version (1 byte), length (1 byte), data (length bytes), Modbus CRC of all of those (2 bytes)
+// so a record from an older layout, a half finished write or blank EEPROM is never loaded
+#define PARAM_STORE_OVERHEAD 4 // bytes a record takes as well as its data
+#define PARAM_STORE_BLANK 0xFF // version byte of erased EEPROM, never a real version
+
+// Records saved often go in a ring of slots, each save to the slot after the newest, so the
+// writes are spread over all of them; the data is prefixed with a sequence number to find the newest
+#define PARAM_RING_MAX 48 // most data a ring record can hold
+#define PARAM_RING_SLOT(length) ((length) + 1 + PARAM_STORE_OVERHEAD) // bytes each slot takes
+
+// Where each record lives
+#define PARAM_STORE_AVR 64 // ring of the AVR's own parameters
+#define PARAM_STORE_AVR_SLOTS 8
+#define PARAM_STORE_CNC 512 // ring of the snapshot of the parameters synchronised from Cnc
+#define PARAM_STORE_CNC_SLOTS 8
+
+byte ParamStoreLoad(word address, void* data, byte length, byte version);
+void ParamStoreSave(word address, const void* data, byte length, byte version);
+void ParamStoreErase(word address);
+byte ParamRingLoad(word address, byte slots, void* data, byte length, byte version);
+void ParamRingSave(word address, byte slots, const void* data, byte length, byte version);
+void ParamRingErase(word address, byte slots, byte length);
+
+#endif /* PARAMSTORE_H_ */
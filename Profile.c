@@ -0,0 +1,68 @@
+/*
+ * Profile.c
+ *
+ * Created: 17/10/2026 15:24:32
+ */
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "Profile.h"
+
+#if (PROFILE_BACKEND == PROFILE_SRAM)
+
+long profilePosition[PROFILE_SIZE];
+long profileForce[PROFILE_SIZE]; // in N * 2^FORCE_FRAC_BITS
+byte profileStatus[PROFILE_SIZE];
+word profileCount = 0;
+word profileLost = 0; // samples not stored because the profile was full
+
+// Empties the profile, ready for a new stroke
+void ProfileClear(void)
+{
+	profileCount = 0;
+	profileLost = 0;
+}
+
+// Stores a sample; returns 0 if the profile is full
+byte ProfileAdd(long position, long force, byte status)
+{
+	if (profileCount >= PROFILE_SIZE)
+	{
+		if (profileLost < 0xFFFF)
+			profileLost++;
+		return 0;
+	}
+	profilePosition[profileCount] = position;
+	profileForce[profileCount] = force;
+	profileStatus[profileCount] = status;
+	profileCount++;
+	return 1;
+}
+
+// Gives the number of samples stored
+word ProfileCount(void)
+{
+	return profileCount;
+}
+
+// Gives the number of samples that did not fit
+word ProfileLost(void)
+{
+	return profileLost;
+}
+
+// Reads a stored sample; returns 0 if there is no sample at index
+byte ProfileRead(word index, long* position, long* force, byte* status)
+{
+	if (index >= profileCount)
+		return 0;
+	*position = profilePosition[index];
+	*force = profileForce[index];
+	*status = profileStatus[index];
+	return 1;
+}
+
+#else
+	#error Unknown PROFILE_BACKEND
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Profile.h
+ *
+ * Created: 17/10/2026 15:21:09
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include "StandardTypes.h"
+
+// Stores every sample of a probe stroke so the robot can fetch it afterwards, however slow it is
+// Backends, pick one at build time with -DPROFILE_BACKEND=...
+//   PROFILE_SRAM - arrays in SRAM, 9 bytes a sample
+// Another backend (e.g. serial FRAM) only needs to provide the functions below
+#define PROFILE_SRAM 0
+
+#ifndef PROFILE_BACKEND
+	#define PROFILE_BACKEND PROFILE_SRAM
+#endif
+
+#ifndef PROFILE_SIZE
+	#define PROFILE_SIZE 256 // samples that can be stored for one stroke
+#endif
+
+// Status stored with each sample; the low bits are the FLOAT_... flags from decoding the force
+#define PROFILE_LIMIT 0x04 // the sample tripped a force limit
+
+void ProfileClear(void);
+byte ProfileAdd(long position, long force, byte status);
+word ProfileCount(void);
+word ProfileLost(void);
+byte ProfileRead(word index, long* position, long* force, byte* status);
+
+#endif /* PROFILE_H_ */
@@ -146,6 +146,9 @@ static struct{
 #if(_TX_FLOWCTRL == UFC_XONXOFF)
   volatile boolean CanTx;
 #endif
+#if defined(UART0_RX_EOL)
+  volatile byte    RxLines;
+#endif
 } Uart0;
 
 #define _Uart Uart0                               // The USART "object"
@@ -213,17 +216,24 @@ static struct{
 #define U_TXC_vect         USART0_TXC_vect
 #define U_UDRE_vect        USART0_UDRE_vect
 
+#if defined(UART0_RX_EOL)
+  #define U_RX_EOL         UART0_RX_EOL          // Receive ISR counts the lines ending with this
+#endif
+
 /*------------ Assign the private generic function name macros to USART1 functions ------------*/
 
 #define U_INIT             uart0_init
 #define U_GETC             uart0_getc
 #define U_GETS             uart0_gets
+#define U_GETBYTES         uart0_getbytes
+#define U_GETLINE          uart0_getline
 #define U_PUTC             uart0_putc
 #define U_PUTS             uart0_puts
 #define U_PUTS_P           uart0_puts_p
 #define U_PUTBYTES         uart0_putbytes
 #define U_STUFF_RX         uart0_stuff_rx
 #define U_TX_BUF_IS_EMPTY  uart0_tx_buffer_is_empty
+#define U_TX_FREE          uart0_tx_free
 
 /*----------------------------------- The actual code for USART0 ------------------------------*/
 
@@ -270,6 +280,9 @@ static struct{
 #if(_TX_FLOWCTRL == UFC_XONXOFF)
   volatile boolean CanTx;
 #endif
+#if defined(UART1_RX_EOL)
+  volatile byte    RxLines;
+#endif
 } Uart1;
 
 #define _Uart      Uart1                          // The UART "object"
@@ -340,17 +353,24 @@ static struct{
 #define U_TXC_vect         USART1_TXC_vect
 #define U_UDRE_vect        USART1_UDRE_vect
 
+#if defined(UART1_RX_EOL)
+  #define U_RX_EOL         UART1_RX_EOL          // Receive ISR counts the lines ending with this
+#endif
+
 /*------------ Assign the private generic function name macros to USART1 functions ------------*/
 
 #define U_INIT             uart1_init
 #define U_GETC             uart1_getc
 #define U_GETS             uart1_gets
+#define U_GETBYTES         uart1_getbytes
+#define U_GETLINE          uart1_getline
 #define U_PUTC             uart1_putc
 #define U_PUTS             uart1_puts
 #define U_PUTS_P           uart1_puts_p
 #define U_PUTBYTES         uart1_putbytes
 #define U_STUFF_RX         uart1_stuff_rx
 #define U_TX_BUF_IS_EMPTY  uart1_tx_buffer_is_empty
+#define U_TX_FREE          uart1_tx_free
 
 /*----------------------------------- The actual code for USART1 ------------------------------*/
 
@@ -465,6 +485,13 @@ static struct{
 #define U_TXC_vect         USART2_TXC_vect
 #define U_UDRE_vect        USART2_UDRE_vect
 
+#if defined(UART2_RX_HOOK)
+  #define U_RX_HOOK        UART2_RX_HOOK          // Application hook called with each received byte
+#endif
+#if defined(UART2_TXC_HOOK)
+  #define U_TXC_HOOK       UART2_TXC_HOOK         // Application hook called when the transmitter goes idle
+#endif
+
 /*------------ Assign the private generic function name macros to USART1 functions ------------*/
 
 #define U_INIT             uart2_init
@@ -476,6 +503,7 @@ static struct{
 #define U_PUTBYTES         uart2_putbytes
 #define U_STUFF_RX         uart2_stuff_rx
 #define U_TX_BUF_IS_EMPTY  uart2_tx_buffer_is_empty
+#define U_TX_FREE          uart2_tx_free
 
 /*----------------------------------- The actual code for USART2 ------------------------------*/
 
@@ -600,6 +628,7 @@ static struct{
 #define U_PUTBYTES         uart3_putbytes
 #define U_STUFF_RX         uart3_stuff_rx
 #define U_TX_BUF_IS_EMPTY  uart3_tx_buffer_is_empty
+#define U_TX_FREE          uart3_tx_free
 
 /*----------------------------------- The actual code for USART3 ------------------------------*/
 
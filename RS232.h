@@ -117,6 +117,32 @@ extern word uart0_getc(void);
 
 extern byte uart0_gets(char *str, int size);
 
+/** @brief  Take a whole UART0_RX_EOL terminated line from the USART0 ringbuffer.
+ *
+ * Does nothing until the receive ISR has seen a whole line (or the ringbuffer is
+ * half full), then copies it straight out of the ringbuffer onto the end of str,
+ * which is kept between calls. Only there when UART0_RX_EOL is defined.
+ *
+ * @param  str  : Buffer for the line
+ * @param  index: Number of bytes already in str, set back to 0 with each line
+ * @param  size : Size of the buffer pointed to by str
+ * @return 1 when str holds a whole, Null terminated line, otherwise 0
+ */
+
+extern byte uart0_getline(char *str, byte *index, byte size);
+
+/** @brief  Take up to count bytes from the USART0 ringbuffer in one go.
+ *
+ * The tail is moved once for all of them, rather than once a byte as
+ * uart0_getc() does. Receive errors are not reported.
+ *
+ * @param  data : Where to put the bytes
+ * @param  count: Most bytes to take
+ * @return Number of bytes taken, 0 if there were none
+ */
+
+extern byte uart0_getbytes(char *data, byte count);
+
 /**
  *  @brief   Put byte to ringbuffer for transmitting by the UART
  *  @param   data byte to be transmitted
@@ -180,6 +206,14 @@ extern void uart0_putbytes(const char *data, byte count);
 
 extern boolean uart0_tx_buffer_is_empty(void);
 
+/**
+ * @brief    Returns how many bytes can be put in the UART0 transmit buffer without blocking
+ *
+ * Lets a caller that must not wait (e.g. a logger) check there is room first.
+*/
+
+extern byte uart0_tx_free(void);
+
 /**
  * @brief   Writes an array of bytes to the receive ringbuffer. Used for debuging.
  *
@@ -209,6 +243,14 @@ extern word uart1_getc(void);
 
 extern byte uart1_gets(char *str, int size);
 
+/** @brief  Take a whole UART1_RX_EOL terminated line from the USART1 ringbuffer. @see uart0_getline */
+
+extern byte uart1_getline(char *str, byte *index, byte size);
+
+/** @brief  Take up to count bytes from the USART1 ringbuffer in one go. @see uart0_getbytes */
+
+extern byte uart1_getbytes(char *data, byte count);
+
 /** @brief  Put byte to ringbuffer for transmitting via USART1 (only available on selected ATmega) @see PcUartPutC */
 
 extern void uart1_putc(char data);
@@ -233,6 +275,10 @@ extern void uart1_putbytes(const char *data, byte count);
 
 extern boolean uart1_tx_buffer_is_empty(void);
 
+/** @brief  Returns how many bytes can be put in the USART1 transmit buffer without blocking */
+
+extern byte uart1_tx_free(void);
+
 /** @brief  Writes an array of bytes to the receive ringbuffer. Used for debugging. */
 
 extern byte uart1_stuff_rx(char *s, byte n);
@@ -271,6 +317,10 @@ extern void uart2_putbytes(const char *data, byte count);
 
 extern boolean uart2_tx_buffer_is_empty(void);
 
+/** @brief  Returns how many bytes can be put in the USART2 transmit buffer without blocking */
+
+extern byte uart2_tx_free(void);
+
 /** @brief  Writes an array of bytes to the receive ringbuffer. Used for debugging. */
 
 extern byte uart2_stuff_rx(char *s, byte n);
@@ -313,6 +363,10 @@ extern void uart3_putbytes(const char *data, byte count);
 
 extern boolean uart3_tx_buffer_is_empty(void);
 
+/** @brief  Returns how many bytes can be put in the USART3 transmit buffer without blocking */
+
+extern byte uart3_tx_free(void);
+
 /** @brief  Writes an array of bytes to the receive ringbuffer. Used for debugging. */
 
 extern byte uart3_stuff_rx(char *s, byte n);
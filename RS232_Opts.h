@@ -94,6 +94,12 @@ NOTES:
 //#define UART0_TX_FLOWCTRL UFC_XONXOFF // To specifically use Xon/Xoff flow control on UART0
 //#define UART0_TX_FLOWCTRL UFC_XONXOFF // To specifically use Xon/Xoff flow control on UART0
 
+// End-of-line byte counted by the receive ISR so uart0_getline() can take a
+// whole line at once. Rem out to remove the count and uart0_getline().
+// Needs UART0_RX_FLOWCTRL UFC_NONE. Used for the lines from the robot.
+
+#define UART0_RX_EOL '\n'
+
 // Define the i/o port and two of its pins to drive the (normally red) 
 // "transmitting" indicator LED and the (normally green) "receiving" LED
 // Rem out the first define to remove the LED indicator code for UART0.
@@ -133,6 +139,10 @@ NOTES:
 //#define UART1_TX_FLOWCTRL UFC_XONXOFF // To specifically use Xon/Xoff flow control on UART1
 //#define UART1_TX_FLOWCTRL UFC_XONXOFF // To specifically use Xon/Xoff flow control on UART1
 
+// As UART0_RX_EOL, for uart1_getline(). Used for the replies from the Cnc.
+
+#define UART1_RX_EOL '\n'
+
 // Define the i/o port and two of its pins to drive the (normally red) 
 // "transmitting" indicator LED and the (normally green) "receiving" LED
 // Rem out the first define to remove the LED indicator code for UART1.
@@ -166,6 +176,23 @@ NOTES:
     #define Uart2RxLedBit   PA2
     #define Uart2TxLedBit   PA3
   #endif
+
+// Application callback from the receive ISR with each byte (and its error bits)
+// before it is put in the receive buffer. Returns true if it has taken the byte,
+// in which case it is not buffered. Rem out to remove the call. It runs inside
+// the ISR, so it must be short and must never wait on UART2.
+// Used by the DCell Modbus master to collect and check replies as they arrive.
+
+  #define UART2_RX_HOOK(Data, Error) DCellRxByte(Data, Error)
+  extern byte DCellRxByte(byte Data, byte Error);
+
+// Application callback from the transmit complete ISR, once the last byte has
+// left the shift register. Rem out to remove the call (and the TXC interrupt if
+// there are no Tx LED's). Used to start the DCell reply timeout from the moment
+// the request is actually out, so nobody has to wait on the Tx LED.
+
+  #define UART2_TXC_HOOK() DCellTxDone()
+  extern void DCellTxDone(void);
 #endif
 
 /*--------------------------- UART3 Options ---------------------------*/
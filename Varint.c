@@ -0,0 +1,47 @@
+/*
+ * Varint.c
+ *
+ * Created: 17/10/2026 16:05:19
+ */
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "Varint.h"
+
+// Writes value to out; returns the number of bytes written
+byte VarintPut(char* out, long value)
+{
+	dword zigzag = ((dword)value << 1) ^ (dword)(value >> 31);
+	byte length = 0;
+	while (zigzag > 0x7F)
+	{
+		out[length++] = (zigzag & 0x7F) | 0x80;
+		zigzag >>= 7;
+	}
+	out[length++] = zigzag;
+	return length;
+}
+
+// Writes the dfDelta frame for count samples, the first at start and each after it step on, to
+// frame; position and force hold the sample the frame is coded against, and are left holding the
+// last one. Returns the number of bytes written
+byte VarintDeltaFrame(char* frame, byte sequence, long start, int step, const long* forces, byte count, long* position, long* force)
+{
+	byte length = 0;
+	if (!(sequence % DELTA_KEY_INTERVAL))
+	{
+		*position = 0;
+		*force = 0;
+	}
+	frame[length++] = sequence;
+	frame[length++] = count;
+	for (byte i = 0; i < count; i++, start += step)
+	{
+		length += VarintPut(&frame[length], start - *position);
+		length += VarintPut(&frame[length], forces[i] - *force);
+		*position = start;
+		*force = forces[i];
+	}
+	return length;
+}
@@ -0,0 +1,27 @@
+/*
+ * Varint.h
+ *
+ * Created: 17/10/2026 16:02:44
+ */
+
+#ifndef VARINT_H_
+#define VARINT_H_
+
+#include "StandardTypes.h"
+
+// Signed numbers are zig-zag coded (0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...) so small numbers
+// of either sign are small, then sent 7 bits a byte, low bits first, with the top bit set on
+// every byte but the last; a long takes 1 to VARINT_MAX bytes. The robot decodes them; see
+// test/VarintTest.c
+#define VARINT_MAX 5
+
+// dfDelta frames: sequence (1 byte), count (1 byte), then for each sample the change in position and
+// in force from the sample before. The sample before the first is the last one sent, or 0 for every
+// DELTA_KEY_INTERVAL'th frame, so the robot can pick up again after a lost frame
+#define DELTA_KEY_INTERVAL 16
+#define DELTA_FRAME_MAX(count) (2 + 2 * VARINT_MAX * (count)) // longest frame of count samples
+
+byte VarintPut(char* out, long value);
+byte VarintDeltaFrame(char* frame, byte sequence, long start, int step, const long* forces, byte count, long* position, long* force);
+
+#endif /* VARINT_H_ */
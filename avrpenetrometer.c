@@ -14,6 +14,13 @@
 #include "AsciiCtrl.h"
 #include "CncCmdCodes.h"
 #include "DCell.h"
+#include "DCellFloat.h"
+#include "EventLog.h"
+#include "Format.h"
+#include "ModbusCrc.h"
+#include "ParamStore.h"
+#include "Profile.h"
+#include "Varint.h"
 #include "RS232_Opts.h"
 #include "StandardTypes.h"
 #include "Std_IO.h"
@@ -23,9 +30,6 @@
 
 #include "avrpenetrometer.h"
 
-byte Index = 0;
-char Line[64];
-
 byte toRobotIndex = 0; // into Robot from AVR
 volatile dword toRobotTime = 0; // time of last message sent to Robot
 byte fromRobotIndex = 0; // from Robot to AVR
@@ -36,22 +40,57 @@ byte toCncIndex = 0; // into CnC from AVR
 dword toCncTime = 0; // time of last message sent to Cnc
 byte fromCncIndex = 0; // from Cnc to AVR
 byte fromCncReady = 0;
-volatile byte waitingForCnc = 0;
+char cncReplyCode = 0; // fromCnc parsed once by CncParseReply: the letter it starts with
+long cncReplyValue = 0; // its value, 0 if it has none
+byte cncReplyFlags = 0; // cncReply... flags
+// Requests sent to Cnc and still waiting for a reply, oldest first
+char cncPendingRsp[CNC_PENDING_SIZE]; // letter the reply starts with
+byte cncPendingSlot[CNC_PENDING_SIZE]; // what is done with the reply (cncSlot...)
+dword cncPendingTime[CNC_PENDING_SIZE]; // tick the request was sent
+word cncPendingTimeout[CNC_PENDING_SIZE]; // ticks the reply can take, 0 for no limit
+byte cncPendingCount = 0;
+byte cncSnapshotUsed = 0; // Init took the parameters from the snapshot and is checking it
+long cncSnapshotCheck[CNC_SNAPSHOT_CHECKS]; // the snapshot's values of the parameters Init reads to check it
 dword fromCncTime = 0; // time of last complete message from Cnc
-byte toDCellIndex = 0; // into DCell from AVR
-volatile dword toDCellTime = 0; // time of last message sent to DCell
-byte fromDCellIndex = 0; // from DCell to AVR
-byte fromDCellReady = 0;
-volatile byte waitingForDCell = 0;
+volatile byte waitingForDCell = 0; // number of DCell commands still waiting for a reply
 dword fromDCellTime = 0; // time of last complete message from DCell
+byte sampleFields = 0; // registers read along with the force in each sample (dcField...)
+word sampleStart = MD_CRAW; // first register read by the sample frame
+word dcellStatus = 0; // MD_STAT from the last sample, if dcFieldStat is set
+word dcellFlags = 0; // MD_FLAG from the last sample, if dcFieldFlag is set
+int dcellTemp = 0; // MD_TEMP in whole degrees from the last sample, if dcFieldTemp is set
+byte dcellBaud = DCELL_BAUD_DEFAULT; // MD_BAUD code UART2 is running at
+byte dcellOldBaud = DCELL_BAUD_DEFAULT; // rate to fall back to if a new one does not work
+byte dcellCheckResult = dcResultNone; // result of the last dcTagCheck transaction
+byte acquireMode = 0; // 0 to ask DCell for the force on each DoSample edge, otherwise the MD_RATE code it streams at
+byte dataFormat = dfAscii; // how force data is sent to the robot (df...)
+byte forceSequence = 0; // sequence number of the next binary force frame
+byte batchSize = 1; // samples sent to the robot in each force data message; 1 sends each as it comes
+word batchFlush = BATCH_FLUSH_DEFAULT; // ms a batch can wait before it is sent part full
+dword batchFlushTicks = MS_TO_TICKS(BATCH_FLUSH_DEFAULT);
+long batchStart = 0; // position of the first sample in the batch
+int batchStep = 0; // position change from one sample in the batch to the next
+long batchForce[BATCH_MAX]; // in N * 2^FORCE_FRAC_BITS
+byte batchCount = 0; // samples in the batch so far
+dword batchTime = 0; // tick when the first sample in the batch was taken off the queue
+word profileIndex = 0; // next stored sample FetchProfile sends
+long deltaPosition = 0; // position the next dfDelta or dfSlip frame is coded against
+long deltaForce = 0; // force the next dfDelta frame is coded against
 
 char toRobot[64];
-char fromRobot[64];
+char fromRobot[ROBOT_LINE_MAX];
+char robotCommand[ROBOT_LINE_MAX]; // line that started currentTask, kept for tasks that need more than currentParameter
+char robotQueueLine[ROBOT_QUEUE_SIZE][ROBOT_LINE_MAX]; // tagged commands waiting for currentTask to finish
+word robotQueueSequence[ROBOT_QUEUE_SIZE];
+byte robotQueueHead = 0;
+byte robotQueueTail = 0;
+byte robotTagged = 0; // currentTask came with a tag, so its end is to be reported
+word robotSequence = 0; // tag of currentTask
 char toCnc[64];
 char fromCnc[64];
 char forcePacket[8];
-char toDCell[16];
-char fromDCell[16];
+char toDCell[DCELL_REQUEST_SIZE];
+char fromDCell[DCELL_FRAME_SIZE];
 byte toDCellLength = 8;
 byte fromDCellLength = 8;
 
@@ -70,15 +109,28 @@ volatile dword robotWatchdog = ROBOT_TIMEOUT;
 volatile dword robotWatchdogState = 0;
 
 byte probeDir = 0;
-byte readSample = 0;
+
+// Samples taken by ISR_DoSample and waiting for the main loop; only the ISR moves the head and only
+// the main loop moves the tail, so neither needs to turn interrupts off. In polled mode each entry
+// is matched to the DCell reply for it, in order; when streaming the reading itself is latched here
+long samplePosition[SAMPLE_QUEUE_SIZE]; // sampleCount when the sample was taken
+dword sampleTime[SAMPLE_QUEUE_SIZE]; // tick when the sample was taken
+char sampleValue[SAMPLE_QUEUE_SIZE][4]; // streamed force register, when streaming
+volatile byte sampleHead = 0;
+volatile byte sampleTail = 0;
+volatile byte sampleHighWater = 0; // most samples waiting at once since probing started
+
 volatile byte errorNum = 0;
 volatile char errorParam = ' ';
 long groundLevel = 2500;
 long maxDepth = 5000;
+long bulkParams[BULK_PARAM_COUNT]; // values taken from an avrSetBulk, waiting for Cnc to accept its share
+byte bulkRefused = 0; // Cnc has refused one of the avrSetBulk values, so all of them are to be undone
 long sampleCount = 0;
 volatile dword tick = 0;
-int lastForce = 0;
-int currentForce = 0;
+long lastForce = 0; // in N * 2^FORCE_FRAC_BITS
+long currentForce = 0; // in N * 2^FORCE_FRAC_BITS
+byte forceFlags = 0; // floatFlags from decoding currentForce
 int maxForce = 100;
 int minForce = -100;
 int maxForceDelta = 100;
@@ -104,33 +156,9 @@ long topSpeed = 0;
 long conValue = 0;
 
 char currentTask = ' ';
-char expectedRsp = ' ';
 long currentParameter = 0;
 byte currentStep = 0;
 
-// Wait until finished transmitting before we start receiving
-
-byte TxWait(void)
-{
-	word c;
-
-	do
-	{
-		while(GetPin(Uart1TxLedPort, Uart1TxLedBit)) // Wait until finished transmitting
-		{
-			c = uart0_getc();
-			if((c != uartNoData) && (Index < sizeof(Line)))
-			{
-				Line[Index] = (c & 0xFF);
-				Index++;
-			}
-		}
-		_delay_ms(2);
-	}
-	while(GetPin(Uart1TxLedPort, Uart1TxLedBit)); // Wait until finished transmitting
-	return(Index);
-}
-
 dword GetTick(void)
 {
 	dword lastTick = tick;
@@ -146,104 +174,40 @@ boolean IsMoving(void)
 
 // *** DCell related methods
 
-// Sends the array toDCell to DCell
+// Queues the array toDCell to be sent to DCell; the reply is left in fromDCell once waitingForDCell clears
+// It is counted before it is queued, so a DCellFlush in between cannot leave it counted
 void DCellTransmit(void)
 {
-	dcell_putbytes(toDCell, toDCellLength);
-	while(GetOutPin(Uart2TxLedPort, Uart2TxLedBit) == 1)                   // Wait for whole line to be Tx'd
-	;
-	toDCellTime = GetTick();
-	waitingForDCell = 1;
+	waitingForDCell++;
+	if (!DCellQueue(toDCell, toDCellLength, dcTagCommand))
+	{
+		if (waitingForDCell)
+			waitingForDCell--;
+		DoEStop(ERR_NO_COMMS, avrErrDCell);
+	}
 }
 
-// Reads bytes from DCell until either the buffer is empty or a complete packet has been received, stores in fromDCell
-void DCellReadChar(void)
+// Queues the array toDCell to be sent to DCell, leaving the result in dcellCheckResult instead of throwing an EStop
+void DCellTransmitCheck(void)
 {
-	if (!fromDCellReady)
+	dcellCheckResult = dcResultNone;
+	waitingForDCell++;
+	if (!DCellQueue(toDCell, toDCellLength, dcTagCheck))
 	{
-		word lastCharacter = 65535;
-		do
-		{
-			word lastCharacter = dcell_getc();
-			if (lastCharacter < 256)
-			{
-				fromDCell[fromDCellIndex++] = lastCharacter;
-				if (fromDCellIndex == fromDCellLength)
-				{
-					fromDCellReady = 1;
-					fromDCellIndex = 0;
-				}
-				if (fromDCellIndex == 2)
-				{
-					switch (lastCharacter)
-					{
-					case 0x03:
-						fromDCellLength = 9;
-						break;
-					case 0x10:
-						fromDCellLength = 8;
-						break;
-					case 0x83:
-						fromDCellLength = 5;
-						break;
-					case 0x90:
-						fromDCellLength = 5;
-						break;
-					default:
-						DoEStop(ERR_NO_COMMS, avrErrDCell);
-						break;
-					}
-				}
-			}
-		} while (lastCharacter < 256 && !fromDCellReady);
-		if (fromDCellReady)
-		{
-			fromDCellTime = GetTick();
-			waitingForDCell = 0;
-		}
-		else if (waitingForDCell && GetTick() - toDCellTime > DCELL_TIMEOUT)
-		{
-			if (logging)
-				robot_puts("# DCell timeout\n");
-			DoEStop(ERR_NO_COMMS, avrErrDCell);
-			waitingForDCell = 0;
-		}
+		if (waitingForDCell)
+			waitingForDCell--;
+		dcellCheckResult = dcResultTimeout;
 	}
 }
 
 // Sets the checksum of a packet stored in toDCell
 void DCellSetChecksum(void)
 {
-	word u16CRC = 0xFFFF;
-	for (byte i = 0; i < toDCellLength - 2; i++)
-	{
-		u16CRC ^= toDCell[i];
-		for (byte j = 0; j < 8; j++)
-		if (u16CRC & 1)
-		u16CRC = (u16CRC >> 1) ^ 0xA001;
-		else
-		u16CRC = (u16CRC >> 1);
-	}
+	word u16CRC = ModbusCrc(toDCell, toDCellLength - 2);
 	toDCell[toDCellLength - 2] = (u16CRC & 0xFF);
 	toDCell[toDCellLength - 1] = (u16CRC >> 8);
 }
 
-// Verifies the checksum of a packet stored in fromDCell (returns 1 if valid and 0 if invalid)
-byte DCellVerifyChecksum(void)
-{
-	word u16CRC = 0xFFFF;
-	for (byte i = 0; i < fromDCellLength - 2; i++)
-	{
-		u16CRC ^= fromDCell[i];
-		for (byte j = 0; j < 8; j++)
-			if (u16CRC & 1)
-				u16CRC = (u16CRC >> 1) ^ 0xA001;
-			else
-				u16CRC = (u16CRC >> 1);
-	}
-	return (fromDCell[fromDCellLength - 2] == (u16CRC & 0xFF) && fromDCell[fromDCellLength - 1] == (u16CRC >> 8));
-}
-
 // Reads a complete packet from DCell, stores in fromDCell - BLOCKING
 void DCellReadPacket(void)
 {
@@ -251,8 +215,8 @@ void DCellReadPacket(void)
 		DCellListen();
 }
 
-// Sends a request to read a specified register - BLOCKING
-void DCellReadCommand(word startRegister)
+// Creates a request to read a specified register in toDCell
+void DCellCreateRead(word startRegister)
 {
 	toDCell[0] = STATION_NUMBER;
 	toDCell[1] = 3;
@@ -262,12 +226,17 @@ void DCellReadCommand(word startRegister)
 	toDCell[5] = 2;
 	toDCellLength = 8;
 	DCellSetChecksum();
+}
+
+// Sends a request to read a specified register
+void DCellRequestRead(word startRegister)
+{
+	DCellCreateRead(startRegister);
 	DCellTransmit();
-	DCellReadPacket();
 }
 
-// Sends a request to write to a specified register - BLOCKING
-void DCellWriteCommand(word startRegister, word lowerRegister, word upperRegister)
+// Creates a request to write to a specified register in toDCell
+void DCellCreateWrite(word startRegister, word lowerRegister, word upperRegister)
 {
 	toDCell[0] = STATION_NUMBER;
 	toDCell[1] = 0x10;
@@ -282,70 +251,303 @@ void DCellWriteCommand(word startRegister, word lowerRegister, word upperRegiste
 	toDCell[10] = upperRegister & 0xFF;
 	toDCellLength = 13;
 	DCellSetChecksum();
-	DCellTransmit();
-	DCellReadPacket();
 }
 
-// Removes unexpected data from buffers
-void DCellFlush(void)
+// Sends a request to write to a specified register
+void DCellRequestWrite(word startRegister, word lowerRegister, word upperRegister)
 {
-	Uart2FlushRxBuffer();
+	DCellCreateWrite(startRegister, lowerRegister, upperRegister);
+	DCellTransmit();
 }
 
-// Creates the packet necessary to request a force reading - this only needs to be done once
+// Creates the packet necessary to request a force reading - this only needs to be done once, or when sampleFields changes
+// Every register from the lowest selected field up to the force is read, so it is all one request
 void CreateForcePacket(void)
 {
+	sampleStart = MD_CRAW;
+	if (sampleFields & dcFieldFlag)
+		sampleStart = MD_FLAG;
+	if (sampleFields & dcFieldTemp)
+		sampleStart = MD_TEMP;
+	if (sampleFields & dcFieldStat)
+		sampleStart = MD_STAT;
 	toDCell[0] = STATION_NUMBER;
 	toDCell[1] = 3;
-	toDCell[2] = 0;
-	toDCell[3] = MD_CRAW;
+	toDCell[2] = sampleStart >> 8;
+	toDCell[3] = sampleStart & 0xFF;
 	toDCell[4] = 0;
-	toDCell[5] = 2;
+	toDCell[5] = MD_CRAW + 2 - sampleStart;
 	toDCellLength = 8;
 	DCellSetChecksum();
 	for (byte i = 0; i < 8; i++)
 		forcePacket[i] = toDCell[i];
 }
 
-// Requests a force reading - BLOCKING
-void DCellGetForce(void)
+// Gives where a register read by the sample frame is in fromDCell
+byte DCellFieldOffset(word reg)
+{
+	return 3 + (reg - sampleStart) * 2;
+}
+
+// Picks the status, temperature and flags out of a sample frame held in fromDCell
+void DCellDecodeSample(void)
+{
+	byte offset;
+	if (sampleFields & dcFieldStat)
+	{
+		offset = DCellFieldOffset(MD_STAT);
+		dcellStatus = ((byte)fromDCell[offset] << 8) | (byte)fromDCell[offset + 1];
+	}
+	if (sampleFields & dcFieldFlag)
+	{
+		offset = DCellFieldOffset(MD_FLAG);
+		dcellFlags = ((byte)fromDCell[offset] << 8) | (byte)fromDCell[offset + 1];
+	}
+	if (sampleFields & dcFieldTemp)
+		dcellTemp = DCellFloatToFixed(&fromDCell[DCellFieldOffset(MD_TEMP)], 0);
+}
+
+// Requests a force reading
+void DCellRequestForce(void)
 {
 	for (byte i = 0; i < 8; i++)
 		toDCell[i] = forcePacket[i];
 	toDCellLength = 8;
 	DCellTransmit();
-	DCellReadPacket();
 }
 
-// Requests the station number - BLOCKING
-void DCellGetStationNumber(void)
+// Takes finished DCell transactions and reacts as necessary
+void DCellListen(void)
+{
+	if (acquireMode && sampleHead != sampleTail)
+	{
+		byte slot = sampleTail & SAMPLE_QUEUE_MASK;
+		ConvertForce(sampleValue[slot]);
+		CheckSample(slot);
+		sampleTail++;
+	}
+	byte tag;
+	byte result = DCellTakeReply(fromDCell, &fromDCellLength, &tag);
+	if (result == dcResultNone)
+		return;
+	fromDCellTime = GetTick();
+	if ((tag == dcTagCommand || tag == dcTagCheck) && waitingForDCell)
+		waitingForDCell--;
+	if (tag == dcTagIgnore)
+		return;
+	if (tag == dcTagSampleIgnore)
+	{
+		// the one sample ISR_Estop left queued for it
+		if (sampleHead != sampleTail)
+			sampleTail++;
+		return;
+	}
+	if (tag == dcTagCheck)
+	{
+		dcellCheckResult = result;
+		return;
+	}
+	if (result == dcResultTimeout)
+	{
+		if (logging)
+			robot_puts("# DCell timeout\n");
+		DoEStop(ERR_NO_COMMS, avrErrDCell);
+	}
+	else if (result != dcResultOk)
+		DoEStop(ERR_NO_COMMS, avrErrDCell);
+	else if (tag == dcTagSample)
+	{
+		ConvertForceToInt();
+		DCellDecodeSample();
+		if ((sampleFields & dcFieldStat) && (dcellStatus & DCELL_STAT_STALE))
+			DoEStop(ERR_HARDWARE_FAULT, avrErrDCell);
+		else if ((sampleFields & dcFieldStat) && (dcellStatus & DCELL_STAT_OVERRANGE))
+			DoEStop(ERR_LIMIT_EXCEEDED, avrErrForce);
+		else
+			CheckSample(sampleTail & SAMPLE_QUEUE_MASK);
+	}
+	if (tag == dcTagSample && sampleHead != sampleTail)
+		sampleTail++;
+}
+
+// Gives the UART2 baud rate register value (double speed) for an MD_BAUD code
+// Returns DCELL_UBRR_NONE if the code is unknown or UART2 cannot get close enough to it at this F_CPU
+word DCellBaudUbrr(byte code)
 {
-	DCellReadCommand(MD_STN);
+	dword rate = DCellBaudRate(code);
+	if (!rate)
+		return DCELL_UBRR_NONE;
+	if (DCELL_BAUD_ERROR(rate) > DCELL_BAUD_ERROR_MAX)
+		return DCELL_UBRR_NONE;
+	return DCELL_UBRR(rate);
 }
 
-// Read from DCell and react as necessary
-void DCellListen(void)
+// Switches UART2 to the rate for an MD_BAUD code; returns 0, leaving UART2 alone, if it cannot be used
+byte DCellSetBaud(byte code)
+{
+	word ubrr = DCellBaudUbrr(code);
+	if (ubrr == DCELL_UBRR_NONE)
+		return 0;
+	Uart2SetBaudrate(ubrr, 1);
+	DCellRtuTiming(DCellBaudRate(code));
+	dcellBaud = code;
+	return 1;
+}
+
+// Moves DCell and UART2 to a new baud rate: MD_BAUD is written at the old rate, UART2 is switched
+// and MD_STN is read back to make sure DCell can be heard. If it cannot, UART2 goes back to the old
+// rate; if DCell cannot be heard there either we have lost it, which is an EStop
+void SetDCellBaud(byte newBaud)
 {
-	DCellReadChar();
-	if (fromDCellReady)
+	if (waitingForDCell)
+		return;
+	switch (currentStep)
 	{
-		fromDCellReady = 0;
-		if (DCellVerifyChecksum())
+	case 0:
+		if (DCellBaudUbrr(newBaud) == DCELL_UBRR_NONE)
 		{
-			if (readSample)
-			{
-				readSample = 0;
-				ConvertForceToInt();
-				if (currentForce > maxForce || currentForce < minForce)
-					DoEStop(ERR_LIMIT_EXCEEDED, avrErrForce);
-				else if ((forceDeltaAbs && (abs(currentForce) - abs(lastForce) > maxForceDelta || abs(currentForce) - abs(lastForce) < minForceDelta)) || (!forceDeltaAbs && (currentForce - lastForce > maxForceDelta || currentForce - lastForce < minForceDelta)))
-					DoEStop(ERR_LIMIT_EXCEEDED, avrErrForceDelta);
-				else if (!isHoming)
-					RobotForceData();
-			}
+			ThrowError(ERR_PARAMETER, avrSetDCellBaud);
+			break;
+		}
+		dcellOldBaud = dcellBaud;
+		DCellCreateWrite(MD_BAUD, newBaud, 0);
+		DCellTransmitCheck();
+		currentStep++;
+		break;
+	case 1:
+		if (dcellCheckResult != dcResultOk)
+		{
+			ThrowError(ERR_NO_COMMS, avrSetDCellBaud);
+			break;
+		}
+		DCellSetBaud(newBaud);
+		DCellCreateRead(MD_STN);
+		DCellTransmitCheck();
+		currentStep++;
+		break;
+	case 2:
+		if (dcellCheckResult == dcResultOk)
+		{
+			RobotSend(avrGetDCellBaud, dcellBaud);
+			currentTask = ' ';
+			break;
+		}
+		if (logging)
+			robot_puts("# DCell baud fallback\n");
+		DCellSetBaud(dcellOldBaud);
+		DCellCreateRead(MD_STN);
+		DCellTransmitCheck();
+		currentStep++;
+		break;
+	case 3:
+		if (dcellCheckResult == dcResultOk)
+		{
+			DCellRequestWrite(MD_BAUD, dcellOldBaud, 0); // so DCell does not move to the new rate later
+			ThrowError(ERR_NO_COMMS, avrSetDCellBaud);
 		}
 		else
+		{
 			DoEStop(ERR_NO_COMMS, avrErrDCell);
+			currentTask = ' ';
+		}
+		break;
+	}
+}
+
+// Checks the force just decoded for a queued sample; a sample acted on this late is no protection
+void CheckSample(byte slot)
+{
+	if (GetTick() - sampleTime[slot] > SAMPLE_MAX_AGE)
+	{
+		if (logging)
+			EventLog(evDCellSlowSample, GetTick(), (byte)(sampleHead - sampleTail));
+		DoEStop(ERR_NO_COMMS, avrErrDCell);
+	}
+	else
+		CheckForce(samplePosition[slot]);
+}
+
+// Checks a new force reading against the limits, stores it in the profile and sends it to the robot
+// The limits are set in whole Newtons, so they are shifted up to compare them with the fixed point force
+void CheckForce(long position)
+{
+	long delta = forceDeltaAbs ? labs(currentForce) - labs(lastForce) : currentForce - lastForce;
+	byte status = forceFlags;
+	if ((forceFlags & FLOAT_SATURATED) || currentForce > FORCE_FROM_N(maxForce) || currentForce < FORCE_FROM_N(minForce))
+	{
+		status |= PROFILE_LIMIT;
+		DoEStop(ERR_LIMIT_EXCEEDED, avrErrForce);
+	}
+	else if (delta > FORCE_FROM_N(maxForceDelta) || delta < FORCE_FROM_N(minForceDelta))
+	{
+		status |= PROFILE_LIMIT;
+		DoEStop(ERR_LIMIT_EXCEEDED, avrErrForceDelta);
+	}
+	else if (!isHoming && dataFormat != dfStore)
+		RobotForceData(position);
+	if (isProbing)
+		ProfileAdd(position, currentForce, status);
+}
+
+// Switches between asking DCell for each reading and having it stream them: MD_RATE is written,
+// then MD_OPCL turns streaming on; 0 writes MD_OPCL to turn it off again
+void SetAcquireMode(int16_t newMode)
+{
+	if (waitingForDCell)
+		return;
+	switch (currentStep)
+	{
+	case 0:
+		if (newMode < 0 || newMode > 255)
+		{
+			ThrowError(ERR_PARAMETER, avrSetAcquireMode);
+			break;
+		}
+		if (newMode)
+		{
+			DCellCreateWrite(MD_RATE, newMode, 0);
+			currentStep = 1;
+		}
+		else
+		{
+			DCellCreateWrite(MD_OPCL, 0, 0);
+			currentStep = 3;
+		}
+		DCellTransmitCheck();
+		break;
+	case 1:
+		if (dcellCheckResult != dcResultOk)
+		{
+			ThrowError(ERR_NO_COMMS, avrSetAcquireMode);
+			break;
+		}
+		DCellStream(1);
+		DCellCreateWrite(MD_OPCL, DCELL_OPCL_STREAM, 0);
+		DCellTransmitCheck();
+		currentStep++;
+		break;
+	case 2:
+		if (dcellCheckResult != dcResultOk)
+		{
+			DCellStream(0);
+			ThrowError(ERR_NO_COMMS, avrSetAcquireMode);
+			break;
+		}
+		acquireMode = newMode;
+		RobotSend(avrGetAcquireMode, acquireMode);
+		currentTask = ' ';
+		break;
+	case 3:
+		if (dcellCheckResult != dcResultOk)
+		{
+			ThrowError(ERR_NO_COMMS, avrSetAcquireMode);
+			break;
+		}
+		DCellStream(0);
+		acquireMode = 0;
+		RobotSend(avrGetAcquireMode, acquireMode);
+		currentTask = ' ';
+		break;
 	}
 }
 
@@ -355,52 +557,45 @@ void DCellPassthrough(void)
 	waitingForRobot = 0;
 	if (logging)
 		robot_puts("# In DCellPassthrough\n");
-	word lastCharacter = 65535;
 	byte flag = 1;
 	while(flag)
 	{
+		// the function code in [1] gives the length of the rest, so take that much first
 		byte i = 0;
-		while (i < toDCellLength)
+		while (i < 2)
+			i += robot_getbytes(&toDCell[i], 2 - i);
+		switch ((byte)toDCell[1])
 		{
-			do
-			{
-				lastCharacter = robot_getc();
-			} while (lastCharacter > 255);
-			toDCell[i] = lastCharacter;
-			if (i == 1)
-			{
-				switch (lastCharacter)
-				{
-				case 0x03:
-					toDCellLength = 8;
-					break;
-				case 0x10:
-					toDCellLength = 13;
-					break;
-				case 0x2A:
-					flag = 0;
-					toDCellLength = 5;
-					break;
-				case 0x83:
-					toDCellLength = 5;
-					break;
-				case 0x90:
-					toDCellLength = 5;
-					break;
-				default:
-					DoEStop(ERR_NO_COMMS, avrErrAvr);
-					break;
-				}
-			}
-			i++;
+		case 0x03:
+			toDCellLength = 8;
+			break;
+		case 0x10:
+			toDCellLength = 13;
+			break;
+		case 0x2A:
+			flag = 0;
+			toDCellLength = 5;
+			break;
+		case 0x83:
+			toDCellLength = 5;
+			break;
+		case 0x90:
+			toDCellLength = 5;
+			break;
+		default:
+			DoEStop(ERR_NO_COMMS, avrErrAvr);
+			break;
 		}
-		dcell_putbytes(toDCell, toDCellLength);
-		while(GetOutPin(Uart2TxLedPort, Uart2TxLedBit) == 1);
+		while (i < toDCellLength)
+			i += robot_getbytes(&toDCell[i], toDCellLength - i);
 		if (flag)
 		{
+			DCellTransmit();
 			DCellReadPacket();
 			robot_putbytes(fromDCell, fromDCellLength);
 		}
+		else
+			DCellQueue(toDCell, toDCellLength, dcTagIgnore);
 	}
 }
 
@@ -411,10 +606,9 @@ long ConvertDMMtoSteps(long inValue)
 	return inValue * STEPS_PER_DMM;
 }
 
-long ConvertStepstoDMM(char* inString)
+long ConvertStepstoDMM(long inValue)
 {
-	conValue = atol(inString);
-	conValue = conValue / STEPS_PER_DMM;
+	conValue = inValue / STEPS_PER_DMM;
 	return conValue;
 }
 
@@ -423,45 +617,49 @@ long ConvertMMtoSteps(long inValue)
 	return inValue * STEPS_PER_MM;
 }
 
-long ConvertStepstoMM(char* inString)
+long ConvertStepstoMM(long inValue)
 {
-	conValue = atol(inString);
-	conValue = conValue / STEPS_PER_MM;
+	conValue = inValue / STEPS_PER_MM;
 	return conValue;
 }
 
-// Converts the force reading received from DCell from float to int
-// This is necessary as we need to act on the force as quickly as possible
-void ConvertForceToInt(void)
+// Converts a force register from DCell to fixed point (see FORCE_FRAC_BITS)
+void ConvertForce(const char* value)
 {
-	// packet    [5]      [6]     [3]     [4]
-	// force  SEEEEEEE EMMMMMMM MMMMMMM MMMMMMM
 	lastForce = currentForce;
-	currentForce = fromDCell[6]; // 00000000 EMMMMMMM
-	currentForce = ((currentForce << 8) | fromDCell[3]) & 0x7FFE; // 0MMMMMMM MMMMMMM0
-	currentForce = currentForce >> 1; // 00MMMMMM MMMMMMMM
-	currentForce = currentForce | 0x4000; // 01MMMMMM MMMMMMMM - this number is actual mantissa << 13
-	
-	word exponent = fromDCell[5]; // 00000000 SEEEEEEE
-	exponent = ((exponent << 8) | fromDCell[6]) & 0x7F80; // 0EEEEEEE E0000000
-	exponent = exponent >> 7; // 00000000 EEEEEEEE - number of times to << (first E is inverted sign bit); should be <= 13
-	if (exponent & 0x80) // if the exponent is positive
-	{
-		exponent = exponent & 0x7F; // remove sign bit
-		if (exponent > 13)
-			currentForce = 32767; // exponent is too large, overflow
-		else if (exponent < 13) // if exponent == 13, do nothing
-		{
-			currentForce = currentForce >> (12 - exponent); // valid exponent
-			if (currentForce & 1) // if fractional part >= 0.5
-				currentForce++; // round up
-			currentForce = currentForce >> 1;
-		}
+	currentForce = DCellFloatToFixed(value, FORCE_FRAC_BITS);
+	forceFlags = floatFlags;
+}
+
+// Converts the force reading received from DCell to fixed point
+void ConvertForceToInt(void)
+{
+	ConvertForce(&fromDCell[DCellFieldOffset(MD_CRAW)]);
+}
+
+// Writes a force into text as Newtons, with ROBOT_FORCE_DECIMALS decimal places; returns its length
+byte FormatForce(long force, char* text)
+{
+#if ROBOT_FORCE_DECIMALS == 0
+	return FormatLong(text, FORCE_TO_N(force));
+#else
+	byte length = 0;
+	if (force < 0)
+	{
+		text[length++] = '-';
+		force = -force;
 	}
-	else
-		currentForce = 0; // exponent is negative, force is -1N < 0 < 1N (also valid)
-	if (fromDCell[5] & 0x80) // if the number is negative
-		currentForce = -currentForce; // negate
+	long whole = force >> FORCE_FRAC_BITS;
+	dword fraction = ((force & (FORCE_ONE - 1)) * ROBOT_FORCE_SCALE + FORCE_ONE / 2) >> FORCE_FRAC_BITS; // rounded to nearest
+	if (fraction >= ROBOT_FORCE_SCALE)
+	{
+		whole++;
+		fraction -= ROBOT_FORCE_SCALE;
+	}
+	length += FormatUnsigned(&text[length], whole);
+	text[length++] = '.';
+	return length + FormatDigits(&text[length], fraction, ROBOT_FORCE_DECIMALS);
+#endif
 }
 
 // *** CNC related methods
@@ -476,67 +674,302 @@ void CncTransmit(char* line)
 	}
 	cnc_puts(line);
 	toCncTime = GetTick();
-	waitingForCnc = 1;
 }
 
-// Reads bytes from Cnc until either the buffer is empty or a complete packet has been received, stores in fromCnc
+// Takes whole lines from Cnc as the receive ISR completes them, until one is not a comment, stores in fromCnc
 void CncReadChar(void)
 {
-	if (!fromCncReady)
+	while (!fromCncReady && cnc_getline(fromCnc, &fromCncIndex, sizeof(fromCnc)))
 	{
-		word lastCharacter = 65535;
-		do 
-		{
-			word lastCharacter = cnc_getc();
-			if (lastCharacter < 256)
-			{
-				if (logging)
-					robot_putc(lastCharacter);
-				fromCnc[fromCncIndex++] = lastCharacter;
-				if (lastCharacter == cncEoL)
-				{
-					fromCnc[fromCncIndex] = 0;
-					fromCncReady = 1;
-					fromCncIndex = 0;
-					if (fromCnc[0] == '#')
-						fromCncReady = 0;
-				}
-			}
-		} while (lastCharacter < 256 && !fromCncReady);
-		if (fromCncReady)
+		if (logging)
+			robot_puts(fromCnc);
+		if (fromCnc[0] != '#')
 		{
+			CncParseReply();
+			fromCncReady = 1;
 			fromCncTime = GetTick();
-			waitingForCnc = 0;
 		}
-		else if (waitingForCnc && GetTick() - toCncTime > CNC_TIMEOUT)
+	}
+}
+
+// Parses the line in fromCnc once, as it arrives, into cncReplyCode, cncReplyValue and cncReplyFlags,
+// so the tasks waiting on it never go back to the text: [0] letter, [1] axis, [2].. signed decimal
+void CncParseReply(void)
+{
+	const char* text = &fromCnc[2];
+	long value = 0;
+	cncReplyCode = fromCnc[0];
+	cncReplyFlags = 0;
+	if (fromCnc[0] == 0 || fromCnc[0] == cncEoL || fromCnc[1] == 0 || fromCnc[1] == cncEoL)
+		text = "";
+	while (*text == ' ')
+		text++;
+	if (*text == '-')
+	{
+		cncReplyFlags |= cncReplyNegative;
+		text++;
+	}
+	else if (*text == '+')
+		text++;
+	while (*text >= '0' && *text <= '9')
+	{
+		value = value * 10 + (*text++ - '0');
+		cncReplyFlags |= cncReplyHasValue;
+	}
+	cncReplyValue = (cncReplyFlags & cncReplyNegative) ? -value : value;
+}
+
+// Takes a command and parameter and sends to Cnc; the reply is the command in upper case
+void CncSend(char cmd, long parameter)
+{
+	CncSendRequest(cmd, parameter, cncSlotTask);
+}
+
+// As CncSend, but the reply goes to slot (see CncRequest)
+void CncSendRequest(char cmd, long parameter, byte slot)
+{
+	toCnc[0] = cmd;
+	toCnc[1] = 'X';
+	byte length = 2 + FormatLong(&toCnc[2], parameter);
+	toCnc[length++] = cncEoL;
+	toCnc[length] = 0;
+	CncRequest(toCnc, cmd < 'a' ? cmd : cmd - 32, CNC_TIMEOUT, slot);
+}
+
+// Reads a complete packet from Cnc, stores in fromCnc - BLOCKING
+void CncReadLine(void)
+{
+	while (CncWaiting())
+		CncListen();
+}
+
+// Sends a line to Cnc and adds the reply it should get to the outstanding requests; several can be
+// in flight at once, as each reply is matched by its letter. timeout is in ticks, 0 for no limit
+void CncRequest(const char* line, char rsp, word timeout, byte slot)
+{
+	if (cncPendingCount >= CNC_PENDING_SIZE)
+	{
+		DoEStop(ERR_NO_COMMS, avrErrCnc);
+		return;
+	}
+	byte i = cncPendingCount++;
+	cncPendingRsp[i] = rsp;
+	cncPendingSlot[i] = slot;
+	cncPendingTime[i] = GetTick();
+	cncPendingTimeout[i] = timeout;
+	CncTransmit((char*)line);
+}
+
+// Sends a query whose reply only needs storing, without waiting for the reply to the last one
+void CncQuery(const char* line, char rsp)
+{
+	CncRequest(line, rsp, CNC_TIMEOUT, cncSlotStore);
+}
+
+// Removes an outstanding request
+void CncRemoveRequest(byte i)
+{
+	cncPendingCount--;
+	for (; i < cncPendingCount; i++)
+	{
+		cncPendingRsp[i] = cncPendingRsp[i + 1];
+		cncPendingSlot[i] = cncPendingSlot[i + 1];
+		cncPendingTime[i] = cncPendingTime[i + 1];
+		cncPendingTimeout[i] = cncPendingTimeout[i + 1];
+	}
+}
+
+// Matches the reply in fromCnc to the oldest request waiting for a reply with its letter, and
+// completes it; returns what was done with it (cncSlot...), cncSlotNone if it was not a reply.
+// Cnc answers its requests in the order they were sent, and an error reply (cncErr...) takes the
+// place of the reply it was refused, so it completes the oldest request, the running task's first;
+// cncSlotNone is returned for it too, so CncListen still acts on the error
+byte CncTakeReply(void)
+{
+	if (CncIsError(cncReplyCode))
+	{
+		if (cncPendingCount)
+		{
+			byte i = 0;
+			while (i < cncPendingCount && cncPendingSlot[i] != cncSlotTask)
+				i++;
+			CncRemoveRequest(i < cncPendingCount ? i : 0);
+		}
+		return cncSlotNone;
+	}
+	for (byte i = 0; i < cncPendingCount; i++)
+	{
+		if (cncPendingRsp[i] == cncReplyCode)
+		{
+			byte slot = cncPendingSlot[i];
+			CncRemoveRequest(i);
+			if (slot == cncSlotStore)
+				CncStoreParam(cncReplyCode, cncReplyValue);
+			return slot;
+		}
+	}
+	return cncSlotNone;
+}
+
+// Gives the number of requests whose replies the running task is waiting for
+byte CncWaiting(void)
+{
+	byte waiting = 0;
+	for (byte i = 0; i < cncPendingCount; i++)
+		if (cncPendingSlot[i] == cncSlotTask)
+			waiting++;
+	return waiting;
+}
+
+// Throws an EStop for each request that has waited too long for its reply
+void CncCheckTimeouts(void)
+{
+	dword now = GetTick();
+	byte i = 0;
+	while (i < cncPendingCount)
+	{
+		if (cncPendingTimeout[i] && now - cncPendingTime[i] > cncPendingTimeout[i])
 		{
 			if (logging)
 				robot_puts("# Cnc timeout\n");
 			DoEStop(ERR_NO_COMMS, avrErrCnc);
-			waitingForCnc = 0;
+			CncRemoveRequest(i);
 		}
+		else
+			i++;
+	}
+}
+
+// Forgets every outstanding request, so none of them times out
+void CncCancelAll(void)
+{
+	cncPendingCount = 0;
+}
+
+// Stores a parameter read from Cnc in the matching variable, converted to AVR units
+void CncStoreParam(char rsp, long value)
+{
+	switch (rsp)
+	{
+	case cmdGetHomeState:
+		homeState = value;
+		break;
+	case cmdGetTopSpeed:
+		topSpeed = ConvertStepstoMM(value);
+		break;
+	case cmdGetSpeed:
+		speed = ConvertStepstoMM(value);
+		break;
+	case cmdGetHomeSpeed:
+		homeSpeed = ConvertStepstoMM(value);
+		break;
+	case cmdGetAccel:
+		acceleration = ConvertStepstoMM(value);
+		break;
+	case cmdGetDecel:
+		deceleration = ConvertStepstoMM(value);
+		break;
+	case cmdGetPosMin:
+		posMin = ConvertStepstoDMM(value);
+		break;
+	case cmdGetPosMax:
+		posMax = ConvertStepstoDMM(value);
+		break;
+	case cmdGetStepsPerX:
+		stepsPerX = ConvertStepstoDMM(value);
+		break;
+	case cmdGetFault:
+		motorFault = value;
+		break;
+	case cmdGetEnable:
+		motorEnable = value;
+		break;
+	case cmdGetAccelMax:
+		accMax = ConvertStepstoMM(value);
+		break;
+	case cmdGetSpeedMax:
+		speedMax = ConvertStepstoMM(value);
+		break;
+	case cmdIsRefHomed:
+		isRefHomed = value;
+		break;
+	case cmdGetEStop:
+		motorEstop = value;
+		break;
 	}
 }
 
-// Takes a command and parameter and sends to Cnc; sets the expected response to ensure reply is valid
-void CncSend(char cmd, long parameter)
+// Saves the parameters synchronised from Cnc to the EEPROM snapshot; only done once Cnc has saved them too
+void CncSnapshotSave(void)
 {
-	toCnc[0] = cmd;
-	toCnc[1] = 'X';
-	ltoa(parameter, &toCnc[2], 10);
-	strcat(toCnc, cncEoLString);
-	CncTransmit(toCnc);
-	if (cmd < 'a')
-		expectedRsp = cmd;
-	else
-		expectedRsp = cmd - 32;
+	long snapshot[CNC_SNAPSHOT_COUNT] = { topSpeed, speed, homeSpeed, acceleration, deceleration, posMin, posMax, stepsPerX, accMax, speedMax };
+	ParamRingSave(PARAM_STORE_CNC, PARAM_STORE_CNC_SLOTS, snapshot, sizeof(snapshot), CNC_SNAPSHOT_VERSION);
 }
 
-// Reads a complete packet from Cnc, stores in fromCnc - BLOCKING
-void CncReadLine(void)
+// Loads the parameters synchronised from Cnc from the EEPROM snapshot; returns 0 if there is none
+byte CncSnapshotLoad(void)
 {
-	while (waitingForCnc)
-		CncListen();
+	long snapshot[CNC_SNAPSHOT_COUNT];
+	if (!ParamRingLoad(PARAM_STORE_CNC, PARAM_STORE_CNC_SLOTS, snapshot, sizeof(snapshot), CNC_SNAPSHOT_VERSION))
+		return 0;
+	topSpeed = snapshot[0];
+	speed = snapshot[1];
+	homeSpeed = snapshot[2];
+	acceleration = snapshot[3];
+	deceleration = snapshot[4];
+	posMin = snapshot[5];
+	posMax = snapshot[6];
+	stepsPerX = snapshot[7];
+	accMax = snapshot[8];
+	speedMax = snapshot[9];
+	return 1;
+}
+
+// Forgets the EEPROM snapshot, when Cnc may no longer have the parameters in it; nothing is
+// written if it is already gone
+void CncSnapshotInvalidate(void)
+{
+	ParamRingErase(PARAM_STORE_CNC, PARAM_STORE_CNC_SLOTS, CNC_SNAPSHOT_COUNT * sizeof(long));
+}
+
+// Queues queries for the parameters Init checks a loaded snapshot by, keeping the snapshot's values
+// to compare the replies with. These are the ones set on Cnc itself, which say whether it is the
+// Cnc and the setup the snapshot was taken from; the speeds are only changed through the AVR or
+// the passthrough, which both forget the snapshot until Cnc saves them
+void CncSnapshotQuery(void)
+{
+	cncSnapshotCheck[0] = stepsPerX;
+	cncSnapshotCheck[1] = posMin;
+	cncSnapshotCheck[2] = posMax;
+	cncSnapshotCheck[3] = accMax;
+	cncSnapshotCheck[4] = speedMax;
+	CncQuery(cncGetStepsPerXCmd, cmdGetStepsPerX);
+	CncQuery(cncGetPosMinCmd, cmdGetPosMin);
+	CncQuery(cncGetPosMaxCmd, cmdGetPosMax);
+	CncQuery(cncGetAccelMaxCmd, cmdGetAccelMax);
+	CncQuery(cncGetSpeedMaxCmd, cmdGetSpeedMax);
+}
+
+// Gives whether the replies to CncSnapshotQuery all match the snapshot
+byte CncSnapshotMatches(void)
+{
+	return stepsPerX == cncSnapshotCheck[0] && posMin == cncSnapshotCheck[1] && posMax == cncSnapshotCheck[2]
+		&& accMax == cncSnapshotCheck[3] && speedMax == cncSnapshotCheck[4];
+}
+
+// Queues queries for all the parameters the snapshot holds
+void CncSyncParams(void)
+{
+	CncQuery(cncGetTopSpeedCmd, cmdGetTopSpeed);
+	CncQuery(cncGetSpeedCmd, cmdGetSpeed);
+	CncQuery(cncGetHomeSpeedCmd, cmdGetHomeSpeed);
+	CncQuery(cncGetAccelCmd, cmdGetAccel);
+	CncQuery(cncGetDecelCmd, cmdGetDecel);
+	CncQuery(cncGetPosMinCmd, cmdGetPosMin);
+	CncQuery(cncGetPosMaxCmd, cmdGetPosMax);
+	CncQuery(cncGetStepsPerXCmd, cmdGetStepsPerX);
+	CncQuery(cncGetAccelMaxCmd, cmdGetAccelMax);
+	CncQuery(cncGetSpeedMaxCmd, cmdGetSpeedMax);
 }
 
 // Removes unexpected data from buffers
@@ -553,32 +986,27 @@ void CncFlush()
 // Sends the appropriate commands to Cnc; sets the expected response to ensure reply is valid
 void CncInit(void)
 {
-	CncTransmit(cncInitCmd);
-	expectedRsp = cmdInit;
+	CncRequest(cncInitCmd, cmdInit, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncDone(void)
 {
-	CncTransmit(cncDoneCmd);
-	expectedRsp = cmdDone;
+	CncRequest(cncDoneCmd, cmdDone, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncSaveParams(void)
 {
-	CncTransmit(cncSaveParamsCmd);
-	expectedRsp = cmdSaveParams;
+	CncRequest(cncSaveParamsCmd, cmdSaveParams, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncSetEStop(void)
 {
-	CncTransmit(cncSetEStopCmd);
-	expectedRsp = cmdGetEStop;
+	CncRequest(cncSetEStopCmd, cmdGetEStop, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncClearEStop(void)
 {
-	CncTransmit(cncClearEStopCmd);
-	expectedRsp = cmdGetEStop;
+	CncRequest(cncClearEStopCmd, cmdGetEStop, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGoTo(long newPosition)
@@ -588,8 +1016,7 @@ void CncGoTo(long newPosition)
 
 void CncRefHome(void)
 {
-	CncTransmit(cncRefHomeCmd);
-	expectedRsp = cmdIsRefHomed;
+	CncRequest(cncRefHomeCmd, cmdIsRefHomed, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncSetTopSpeed(long newTopSpeed)
@@ -669,136 +1096,122 @@ void CncSimLimitSw(long newSimLimitSw)
 
 void CncGetTargetPos(void)
 {
-	CncTransmit(cncGetTargetPosCmd);
-	expectedRsp = cmdGetTargetPos;
+	CncRequest(cncGetTargetPosCmd, cmdGetTargetPos, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetHomeState(void)
 {
-	CncTransmit(cncGetHomeStateCmd);
-	expectedRsp = cmdGetHomeState;
+	CncRequest(cncGetHomeStateCmd, cmdGetHomeState, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetTopSpeed(void)
 {
-	CncTransmit(cncGetTopSpeedCmd);
-	expectedRsp = cmdGetTopSpeed;
+	CncRequest(cncGetTopSpeedCmd, cmdGetTopSpeed, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetSpeed(void)
 {
-	CncTransmit(cncGetSpeedCmd);
-	expectedRsp = cmdGetSpeed;
+	CncRequest(cncGetSpeedCmd, cmdGetSpeed, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetHomeSpeed(void)
 {
-	CncTransmit(cncGetHomeSpeedCmd);
-	expectedRsp = cmdGetHomeSpeed;
+	CncRequest(cncGetHomeSpeedCmd, cmdGetHomeSpeed, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetAccel(void)
 {
-	CncTransmit(cncGetAccelCmd);
-	expectedRsp = cmdGetAccel;
+	CncRequest(cncGetAccelCmd, cmdGetAccel, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetDecel(void)
 {
-	CncTransmit(cncGetDecelCmd);
-	expectedRsp = cmdGetDecel;
+	CncRequest(cncGetDecelCmd, cmdGetDecel, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetPosMin(void)
 {
-	CncTransmit(cncGetPosMinCmd);
-	expectedRsp = cmdGetPosMin;
+	CncRequest(cncGetPosMinCmd, cmdGetPosMin, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetPosMax(void)
 {
-	CncTransmit(cncGetPosMaxCmd);
-	expectedRsp = cmdGetPosMax;
+	CncRequest(cncGetPosMaxCmd, cmdGetPosMax, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetPulseW(void)
 {
-	CncTransmit(cncGetPulseWCmd);
-	expectedRsp = cmdGetPulseW;
+	CncRequest(cncGetPulseWCmd, cmdGetPulseW, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetBaseFreq(void)
 {
-	CncTransmit(cncGetBaseFreqCmd);
-	expectedRsp = cmdGetBaseFreq;
+	CncRequest(cncGetBaseFreqCmd, cmdGetBaseFreq, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetStepsPerX(void)
 {
-	CncTransmit(cncGetStepsPerXCmd);
-	expectedRsp = cmdGetStepsPerX;
+	CncRequest(cncGetStepsPerXCmd, cmdGetStepsPerX, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetDirInvert(void)
 {
-	CncTransmit(cncGetDirInvertCmd);
-	expectedRsp = cmdGetDirInvert;
+	CncRequest(cncGetDirInvertCmd, cmdGetDirInvert, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetEnInvert(void)
 {
-	CncTransmit(cncGetEnInvertCmd);
-	expectedRsp = cmdGetEnInvert;
+	CncRequest(cncGetEnInvertCmd, cmdGetEnInvert, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetEStop(void)
 {
-	CncTransmit(cncGetEStopCmd);
-	expectedRsp = cmdGetEStop;
+	CncRequest(cncGetEStopCmd, cmdGetEStop, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetEnable(void)
 {
-	CncTransmit(cncGetEnableCmd);
-	expectedRsp = cmdGetEnable;
+	CncRequest(cncGetEnableCmd, cmdGetEnable, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetFault(void)
 {
-	CncTransmit(cncGetFaultCmd);
-	expectedRsp = cmdGetFault;
+	CncRequest(cncGetFaultCmd, cmdGetFault, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetAccelMax(void)
 {
-	CncTransmit(cncGetAccelMaxCmd);
-	expectedRsp = cmdGetAccelMax;
+	CncRequest(cncGetAccelMaxCmd, cmdGetAccelMax, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncGetSpeedMax(void)
 {
-	CncTransmit(cncGetSpeedMaxCmd);
-	expectedRsp = cmdGetSpeedMax;
+	CncRequest(cncGetSpeedMaxCmd, cmdGetSpeedMax, CNC_TIMEOUT, cncSlotTask);
 }
 
 void CncIsRefHomed(void)
 {
-	CncTransmit(cncIsRefHomedCmd);
-	expectedRsp = cmdIsRefHomed;
+	CncRequest(cncIsRefHomedCmd, cmdIsRefHomed, CNC_TIMEOUT, cncSlotTask);
 }
 
 // Read from Cnc and react as necessary
 void CncListen(void)
 {
 	CncReadChar();
+	CncCheckTimeouts();
 	if (fromCncReady)
 	{
-		if (fromCnc[0] != expectedRsp)
+		byte slot = CncTakeReply();
+		if (slot == cncSlotStore)
+			fromCncReady = 0;
+		else if (slot == cncSlotNone && currentTask == avrSetBulk && (cncReplyCode == cncErrParameter || cncReplyCode == cncErrState))
+			; // a refusal, left in fromCnc for SetBulk to undo the rest of the line
+		else if (slot == cncSlotNone)
 		{
-			switch (fromCnc[0])
+			switch (cncReplyCode)
 			{
 			case cmdGetEStop:
-				motorEstop = atol(&fromCnc[2]);
+				motorEstop = cncReplyValue;
 				if (motorEstop && currentTask != avrInit)
 				{
 					estop = motorEstop;
@@ -842,20 +1255,20 @@ void CncListen(void)
 void CncPassthrough(void)
 {
 	waitingForRobot = 0;
+	CncSnapshotInvalidate(); // the robot can change anything on Cnc from here
 	if (logging)
 		robot_puts("# In CncPassthrough\n");
-	word lastCharacter = 65535;
+	char relay[16];
 	byte flag = 5;
 	while(flag)
 	{
-		lastCharacter = cnc_getc();
-		if (lastCharacter < 256)
-			robot_putc(lastCharacter);
-		lastCharacter = robot_getc();
-		if (lastCharacter < 256)
+		robot_putbytes(relay, cnc_getbytes(relay, sizeof(relay)));
+		// never more than the '*'s still needed, so nothing after the last is taken from the robot
+		byte count = robot_getbytes(relay, flag);
+		cnc_putbytes(relay, count);
+		for (byte i = 0; i < count; i++)
 		{
-			cnc_putc(lastCharacter);
-			if (lastCharacter == '*')
+			if (relay[i] == '*')
 				flag--;
 			else
 				flag = 5;
@@ -875,27 +1288,17 @@ void RobotTransmit(char* line)
 	robot_puts(line);
 }
 
-// Reads bytes from robot until either the buffer is empty or a complete packet has been received, stores in fromRobot
+// Takes a whole line from robot once the receive ISR has one, stores in fromRobot
 void RobotReadChar(void)
 {
 	if (!fromRobotReady)
 	{
-		word lastCharacter = 65535;
-		do 
+		// an overlong line is cut short rather than overrunning
+		if (robot_getline(fromRobot, &fromRobotIndex, ROBOT_LINE_MAX))
 		{
-			lastCharacter = robot_getc();
-			if (lastCharacter < 256)
-			{
-				robotWatchdog = ROBOT_TIMEOUT;
-				fromRobot[fromRobotIndex++] = lastCharacter;
-				if (lastCharacter == avrEoL)
-				{
-					fromRobot[fromRobotIndex] = 0;
-					fromRobotReady = 1;
-					fromRobotIndex = 0;
-				}
-			}
-		} while (lastCharacter < 256 && !fromRobotReady);
+			robotWatchdog = ROBOT_TIMEOUT;
+			fromRobotReady = 1;
+		}
 		if (robotWatchdogState)
 		{
 			robotWatchdog = ROBOT_TIMEOUT;
@@ -912,28 +1315,307 @@ void RobotReadChar(void)
 void RobotSend(char cmd, word parameter)
 {
 	toRobot[0] = cmd;
-	itoa(parameter, &toRobot[1], 10);
-	strcat(toRobot, avrEoLString);
+	byte length = 1 + FormatLong(&toRobot[1], (int)parameter); // signed, as itoa had it
+	toRobot[length++] = avrEoL;
+	toRobot[length] = 0;
+	RobotTransmit(toRobot);
+}
+
+// As RobotSend, but for bitmasks such as DCell's status and flags, which are sent unsigned
+void RobotSendUnsigned(char cmd, word parameter)
+{
+	toRobot[0] = cmd;
+	byte length = 1 + FormatUnsigned(&toRobot[1], parameter);
+	toRobot[length++] = avrEoL;
+	toRobot[length] = 0;
 	RobotTransmit(toRobot);
 }
 
 // Sends force data to robot; this is done repeatedly while probing,
 // and these are the only unsolicited messages sent to the robot
-void RobotForceData(void)
+void RobotForceData(long position)
 {
-	RobotTransmit(avrDataString);
-	itoa(sampleCount, &toRobot[0], 10);
-	RobotTransmit(toRobot);
-	RobotTransmit(avrDataSeparatorString);
-	itoa(currentForce, &toRobot[0], 10);
-	RobotTransmit(toRobot);
-	RobotTransmit(avrEoLString);
+	if (batchSize > 1)
+	{
+		RobotBatchForce(position);
+		return;
+	}
+	if (dataFormat == dfSlip)
+	{
+		RobotForceFrame(position);
+		return;
+	}
+	if (dataFormat == dfDelta)
+	{
+		RobotDeltaFrame(position, 0, &currentForce, 1);
+		return;
+	}
+	byte length = 0;
+	toRobot[length++] = avrData;
+	length += FormatLong(&toRobot[length], position);
+	toRobot[length++] = avrDataSeparator;
+	length += FormatForce(currentForce, &toRobot[length]);
+	toRobot[length++] = avrEoL;
+	robot_putbytes(toRobot, length);
+}
+
+// Sends force data to robot as one SLIP frame, so nothing has to be converted to decimal:
+// sequence number (1 byte), the change in position from the last frame (2 bytes), force (3 bytes,
+// see FramePutForce), all little endian, then the Modbus CRC of those 6 bytes; 10 bytes with the
+// ENDs, however large the position and force and however many decimals. Every DELTA_KEY_INTERVAL'th
+// frame, and any whose change does not fit, is a FORCE_KEY_FRAME_SIZE key frame with the whole
+// position (4 bytes) instead, so the robot can pick up again after a lost frame. SLIP_END never
+// appears in an ASCII reply, so the robot can tell frames from the lines it still gets for
+// everything else
+void RobotForceFrame(long position)
+{
+	char frame[FORCE_KEY_FRAME_SIZE];
+	byte length = 0;
+	long change = position - deltaPosition;
+	byte key = !(forceSequence % DELTA_KEY_INTERVAL) || change > 32767 || change < -32768;
+	frame[length++] = forceSequence++;
+	if (key)
+		for (byte i = 0; i < 4; i++)
+			frame[length++] = (position >> (8 * i)) & 0xFF;
+	else
+	{
+		frame[length++] = change & 0xFF;
+		frame[length++] = (change >> 8) & 0xFF;
+	}
+	deltaPosition = position;
+	length += FramePutForce(&frame[length], currentForce);
+	word u16CRC = ModbusCrc(frame, length);
+	frame[length++] = (u16CRC & 0xFF);
+	frame[length++] = (u16CRC >> 8);
+	RobotSlipSend(frame, length);
+}
+
+// Writes force to out as 3 bytes, little endian, in N * 2^FRAME_FORCE_FRAC_BITS rounded to
+// nearest and held to the 24 bits; returns 3
+byte FramePutForce(char* out, long force)
+{
+#if FORCE_FRAC_BITS > FRAME_FORCE_FRAC_BITS
+	force = (force + (1L << (FORCE_FRAC_BITS - FRAME_FORCE_FRAC_BITS - 1))) >> (FORCE_FRAC_BITS - FRAME_FORCE_FRAC_BITS);
+#endif
+	if (force > 0x7FFFFFL)
+		force = 0x7FFFFFL;
+	else if (force < -0x800000L)
+		force = -0x800000L;
+	out[0] = force & 0xFF;
+	out[1] = (force >> 8) & 0xFF;
+	out[2] = (force >> 16) & 0xFF;
+	return 3;
+}
+
+// SLIP encodes a frame into toRobot and sends it, a whole buffer at a time
+void RobotSlipSend(const char* frame, byte length)
+{
+	byte index = 0;
+	// a leading END flushes any line noise the robot may have picked up
+	toRobot[index++] = SLIP_END;
+	for (byte i = 0; i < length; i++)
+	{
+		if (index > sizeof(toRobot) - 3) // room for an escaped byte and the END
+		{
+			robot_putbytes(toRobot, index);
+			index = 0;
+		}
+		switch ((byte)frame[i])
+		{
+		case SLIP_END:
+			toRobot[index++] = SLIP_ESC;
+			toRobot[index++] = SLIP_ESC_END;
+			break;
+		case SLIP_ESC:
+			toRobot[index++] = SLIP_ESC;
+			toRobot[index++] = SLIP_ESC_ESC;
+			break;
+		default:
+			toRobot[index++] = frame[i];
+			break;
+		}
+	}
+	toRobot[index++] = SLIP_END;
+	robot_putbytes(toRobot, index);
+}
+
+// Adds the force to the batch, sending the batch first if the position does not follow on from it
+// by the same step, and afterwards if it is full
+void RobotBatchForce(long position)
+{
+	if (batchCount)
+	{
+		long step = position - batchStart;
+		if (batchCount > 1)
+			step -= (long)batchStep * (batchCount - 1);
+		if ((batchCount > 1 && step != batchStep) || step > 32767 || step < -32768)
+			RobotFlushBatch();
+		else if (batchCount == 1)
+			batchStep = step;
+	}
+	if (!batchCount)
+	{
+		batchStart = position;
+		batchStep = 0;
+		batchTime = GetTick();
+	}
+	batchForce[batchCount++] = currentForce;
+	if (batchCount >= batchSize)
+		RobotFlushBatch();
+}
+
+// Sends the samples batched so far, if any
+// ASCII:  +<start>,<step>,<force>,<force>...\n
+// Binary: sequence (1 byte), count (1), start (4), step (2), then count forces (3 each, as
+//         FramePutForce), all little endian, and the Modbus CRC; it is never the size of a single
+//         sample frame. The last position is what the next single sample frame is coded against
+void RobotFlushBatch(void)
+{
+	if (!batchCount)
+		return;
+	if (dataFormat == dfDelta)
+		RobotDeltaFrame(batchStart, batchStep, batchForce, batchCount);
+	else if (dataFormat == dfSlip)
+	{
+		char frame[10 + 3 * BATCH_MAX];
+		byte length = 0;
+		long value = batchStart;
+		frame[length++] = forceSequence++;
+		frame[length++] = batchCount;
+		for (byte i = 0; i < 4; i++, value >>= 8)
+			frame[length++] = value & 0xFF;
+		frame[length++] = batchStep & 0xFF;
+		frame[length++] = batchStep >> 8;
+		for (byte j = 0; j < batchCount; j++)
+			length += FramePutForce(&frame[length], batchForce[j]);
+		deltaPosition = batchStart + (long)batchStep * (batchCount - 1);
+		word u16CRC = ModbusCrc(frame, length);
+		frame[length++] = (u16CRC & 0xFF);
+		frame[length++] = (u16CRC >> 8);
+		RobotSlipSend(frame, length);
+	}
+	else
+	{
+		byte length = 0;
+		toRobot[length++] = avrBatch;
+		length += FormatLong(&toRobot[length], batchStart);
+		toRobot[length++] = avrDataSeparator;
+		length += FormatLong(&toRobot[length], batchStep);
+		robot_putbytes(toRobot, length);
+		for (byte j = 0; j < batchCount; j++)
+		{
+			toRobot[0] = avrDataSeparator;
+			robot_putbytes(toRobot, 1 + FormatForce(batchForce[j], &toRobot[1]));
+		}
+		robot_putc(avrEoL);
+	}
+	batchCount = 0;
+}
+
+// Sends the stored profile from sample start on, as .<position>,<force>,<status> lines (or frames, for
+// dfDelta), only as fast as the transmit buffer empties so it never blocks; ends with .<samples stored>
+// It is allowed after an EStop, so the robot can see what led up to it
+void FetchProfile(long start)
+{
+	long position;
+	long force;
+	byte status;
+	if (currentStep == 0)
+	{
+		if (start < 0 || start > ProfileCount())
+		{
+			ThrowError(ERR_PARAMETER, avrFetchProfile);
+			return;
+		}
+		profileIndex = start;
+		currentStep++;
+	}
+	while (dataFormat == dfDelta && robot_tx_free() >= PROFILE_FRAME_MAX && profileIndex < ProfileCount())
+		FetchProfileFrame();
+	while (dataFormat != dfDelta && robot_tx_free() >= PROFILE_LINE_MAX && ProfileRead(profileIndex, &position, &force, &status))
+	{
+		byte length = 0;
+		toRobot[length++] = avrFetchProfile;
+		length += FormatLong(&toRobot[length], position);
+		toRobot[length++] = avrDataSeparator;
+		length += FormatForce(force, &toRobot[length]);
+		toRobot[length++] = avrDataSeparator;
+		length += FormatUnsigned(&toRobot[length], status);
+		toRobot[length++] = avrEoL;
+		robot_putbytes(toRobot, length);
+		profileIndex++;
+	}
+	if (profileIndex >= ProfileCount())
+	{
+		if (logging && ProfileLost())
+		{
+			robot_puts("# Profile full, samples lost ");
+			FormatUnsigned(toRobot, ProfileLost());
+			robot_puts(toRobot);
+			robot_putc(avrEoL);
+		}
+		RobotSend(avrFetchProfile, ProfileCount());
+		currentTask = ' ';
+	}
+}
+
+// Sends count samples to robot as one SLIP frame of varints, coded by VarintDeltaFrame (see
+// Varint.h), followed by the Modbus CRC; forces are in N * 2^FORCE_FRAC_BITS.
+// A probe moves smoothly, so a sample usually takes 3 or 4 bytes
+void RobotDeltaFrame(long start, int step, const long* forces, byte count)
+{
+	char frame[DELTA_FRAME_MAX(BATCH_MAX) + 2];
+	byte length = VarintDeltaFrame(frame, forceSequence++, start, step, forces, count, &deltaPosition, &deltaForce);
+	word u16CRC = ModbusCrc(frame, length);
+	frame[length++] = (u16CRC & 0xFF);
+	frame[length++] = (u16CRC >> 8);
+	RobotSlipSend(frame, length);
+}
+
+// Sends the next PROFILE_CHUNK stored samples as a dfDelta style SLIP frame: index of the first
+// (2 bytes), count (1 byte), then for each sample the position and force varints, coded against
+// the sample before with the first coded against 0, and the status; then the Modbus CRC
+void FetchProfileFrame(void)
+{
+	char frame[5 + PROFILE_CHUNK * (2 * VARINT_MAX + 1)];
+	byte length = 0;
+	long position;
+	long force;
+	long previousPosition = 0;
+	long previousForce = 0;
+	byte status;
+	frame[length++] = profileIndex & 0xFF;
+	frame[length++] = profileIndex >> 8;
+	length++; // count, filled in below
+	byte count = 0;
+	while (count < PROFILE_CHUNK && ProfileRead(profileIndex, &position, &force, &status))
+	{
+		length += VarintPut(&frame[length], position - previousPosition);
+		length += VarintPut(&frame[length], force - previousForce);
+		frame[length++] = status;
+		previousPosition = position;
+		previousForce = force;
+		profileIndex++;
+		count++;
+	}
+	frame[2] = count;
+	word u16CRC = ModbusCrc(frame, length);
+	frame[length++] = (u16CRC & 0xFF);
+	frame[length++] = (u16CRC >> 8);
+	RobotSlipSend(frame, length);
+}
+
+// Sends a part full batch once its first sample has waited batchFlush ms
+void RobotBatchTimer(void)
+{
+	if (batchCount && GetTick() - batchTime >= batchFlushTicks)
+		RobotFlushBatch();
 }
 
 // Performs the requested tasks
 void Init(void)
 {
-	if (currentStep == 0 || fromCncReady)
+	if (currentStep == 0 || (currentStep == 1 && fromCncReady && !waitingForDCell) || (currentStep == 2 && !cncPendingCount))
 	{
 		fromCncReady = 0;
 		switch (currentStep)
@@ -945,77 +1627,50 @@ void Init(void)
 			errorNum = 0;
 			CreateForcePacket();
 			
-			// check communications with DCell
-			DCellGetStationNumber();
+			// check communications with DCell; the answer is looked at in step 1
+			DCellCreateRead(MD_STN);
+			DCellTransmitCheck();
 			
 			// check communications with Cnc
 			CncFlush();
+			CncCancelAll();
 			CncInit();
 			break;
 		case 1:
-			// start synchronising parameters with Cnc
-			CncGetHomeState();
+			if (dcellCheckResult != dcResultOk)
+			{
+				DoEStop(ERR_NO_COMMS, avrErrDCell);
+				GetError();
+				return;
+			}
+			
+			// synchronise parameters with Cnc; the queries all go at once and CncListen stores
+			// each reply as it comes, so this takes about one round trip rather than one each.
+			// If the EEPROM snapshot is good only the parameters CncSnapshotQuery names are read, to check it
+			CncQuery(cncGetHomeStateCmd, cmdGetHomeState);
+			cncSnapshotUsed = CncSnapshotLoad();
+			if (cncSnapshotUsed)
+				CncSnapshotQuery();
+			else
+				CncSyncParams();
+			CncQuery(cncGetFaultCmd, cmdGetFault);
+			CncQuery(cncGetEnableCmd, cmdGetEnable);
+			CncQuery(cncIsRefHomedCmd, cmdIsRefHomed);
+			CncQuery(cncGetEStopCmd, cmdGetEStop);
 			break;
 		case 2:
-			homeState = atol(&fromCnc[2]);
-			CncGetTopSpeed();
-			break;
-		case 3:
-			topSpeed = ConvertStepstoMM(&fromCnc[2]);
-			CncGetSpeed();
-			break;
-		case 4:
-			speed = ConvertStepstoMM(&fromCnc[2]);
-			CncGetHomeSpeed();
-			break;
-		case 5:
-			homeSpeed = ConvertStepstoMM(&fromCnc[2]);
-			CncGetAccel();
-			break;
-		case 6:
-			acceleration = ConvertStepstoMM(&fromCnc[2]);
-			CncGetDecel();
-			break;
-		case 7:
-			deceleration = ConvertStepstoMM(&fromCnc[2]);
-			CncGetPosMin();
-			break;
-		case 8:
-			posMin = ConvertStepstoDMM(&fromCnc[2]);
-			CncGetPosMax();
-			break;
-		case 9:
-			posMax = ConvertStepstoDMM(&fromCnc[2]);
-			CncGetStepsPerX();
-			break;
-		case 10:
-			stepsPerX = ConvertStepstoDMM(&fromCnc[2]);
-			CncGetFault();
-			break;
-		case 11:
-			motorFault = atol(&fromCnc[2]);
-			CncGetEnable();
-			break;
-		case 12:
-			motorEnable = atol(&fromCnc[2]);
-			CncGetAccelMax();
-			break;
-		case 13:
-			accMax = ConvertStepstoMM(&fromCnc[2]);
-			CncGetSpeedMax();
-			break;
-		case 14:
-			speedMax = ConvertStepstoMM(&fromCnc[2]);
-			CncIsRefHomed();
-			break;
-		case 15:
-			isRefHomed = atol(&fromCnc[2]);
+			if (cncSnapshotUsed && !CncSnapshotMatches())
+			{
+				// Cnc is not the one the snapshot was taken from, so read everything after all
+				if (logging)
+					robot_puts("# Cnc snapshot stale\n");
+				CncSnapshotInvalidate();
+				cncSnapshotUsed = 0;
+				CncSyncParams();
+				return;
+			}
 			if (isRefHomed == 1)
 				probeState = 0;
-			CncGetEStop();
-			break;
-		case 16:
-			motorEstop = atol(&fromCnc[2]);
 			estop = motorEstop;
 			RobotSend(avrInit, 1);
 			currentTask = ' ';
@@ -1030,15 +1685,44 @@ void Done(void)
 	currentTask = ' ';
 }
 
+// Saves the parameters set through SetParamAvr to EEPROM
+void AvrParamsSave(void)
+{
+	long params[AVR_PARAMS_COUNT] = { groundLevel, maxDepth, LFDtolerance, maxForce, minForce, maxForceDelta, minForceDelta, forceDeltaAbs, safeDisconnect };
+	ParamRingSave(PARAM_STORE_AVR, PARAM_STORE_AVR_SLOTS, params, sizeof(params), AVR_PARAMS_VERSION);
+}
+
+// Loads the parameters set through SetParamAvr from EEPROM; returns 0, leaving the defaults, if
+// they have never been saved
+byte AvrParamsLoad(void)
+{
+	long params[AVR_PARAMS_COUNT];
+	if (!ParamRingLoad(PARAM_STORE_AVR, PARAM_STORE_AVR_SLOTS, params, sizeof(params), AVR_PARAMS_VERSION))
+		return 0;
+	groundLevel = params[0];
+	maxDepth = params[1];
+	LFDtolerance = params[2];
+	LFDcount = LFDtolerance;
+	maxForce = params[3];
+	minForce = params[4];
+	maxForceDelta = params[5];
+	minForceDelta = params[6];
+	forceDeltaAbs = params[7];
+	safeDisconnect = params[8];
+	return 1;
+}
+
 void Save(void)
 {
 	if (currentStep == 0)
 	{
+		AvrParamsSave();
 		CncSaveParams();
 		currentStep++;
 	}
 	else if (fromCncReady)
 	{
+		CncSnapshotSave();
 		RobotSend(avrSave, 1);
 		currentTask = ' ';
 	}
@@ -1055,19 +1739,22 @@ void DoProbe(byte newProbeDir)
 {
 	if (!isProbing)
 	{
-		if (currentStep == 0 || fromCncReady)
+		if (currentStep == 0 || (fromCncReady && !waitingForDCell))
 		{
 			switch (currentStep)
 			{
 			case 0:
-				DCellGetForce();
-				ConvertForceToInt();
-				lastForce = currentForce;
+				DCellRequestForce();
 				CncGetTargetPos();
 				break;
 			case 1:
+				ConvertForceToInt();
+				lastForce = currentForce;
+				sampleTail = sampleHead;
+				sampleHighWater = 0;
+				ProfileClear();
 				fromCncReady = 0;
-				sampleCount = ConvertStepstoDMM(&fromCnc[2]) - groundLevel;
+				sampleCount = ConvertStepstoDMM(cncReplyValue) - groundLevel;
 				isHoming = 0;
 				startedMoving = 0;
 				isProbing = 1;
@@ -1092,8 +1779,9 @@ void DoProbe(byte newProbeDir)
 	}
 	else if (startedMoving && !IsMoving())
 	{
-		if (!readSample) // wait for last sample to finish being read and sent before confirming end of probing
+		if (sampleHead == sampleTail) // wait for the last sample to finish being read and sent before confirming end of probing
 		{
+			RobotFlushBatch();
 			startedMoving = 0;
 			isProbing = 0;
 			probeState = probeDir;
@@ -1112,19 +1800,17 @@ void DoRefHome(void)
 		switch (currentStep)
 		{
 		case 0:
-			CncTransmit(cncRefHomeCmd);
-			expectedRsp = cmdIsRefHomed;
-			waitingForCnc = 0;
+			CncRequest(cncRefHomeCmd, cmdIsRefHomed, 0, cncSlotTask); // homing takes as long as it takes
 			break;
 		case 1:
 			CncIsRefHomed();
 			break;
 		case 2:
-			isRefHomed = atol(&fromCnc[2]);
+			isRefHomed = cncReplyValue;
 			CncGetHomeState();
 			break;
 		case 3:
-			homeState = atol(&fromCnc[2]);
+			homeState = cncReplyValue;
 			isHoming = 0;
 			if (isRefHomed == 1)
 				probeState = 0;
@@ -1166,7 +1852,7 @@ void SetEStop(word newEstop)
 			break;
 		case 1:
 			SetPinDir(port_Estop, pin_Estop, dirInput);
-			motorEstop = atol(&fromCnc[2]);
+			motorEstop = cncReplyValue;
 			if (motorEstop)
 			{
 				estop = 1;
@@ -1271,6 +1957,39 @@ void GetParamAvr(void)
 		case avrGetProbeState:
 			RobotSend(avrGetProbeState, probeState);
 			break;
+		case avrGetSampleFields:
+			RobotSend(avrGetSampleFields, sampleFields);
+			break;
+		case avrGetDCellStatus:
+			RobotSendUnsigned(avrGetDCellStatus, dcellStatus);
+			break;
+		case avrGetDCellTemp:
+			RobotSend(avrGetDCellTemp, dcellTemp);
+			break;
+		case avrGetDCellFlags:
+			RobotSendUnsigned(avrGetDCellFlags, dcellFlags);
+			break;
+		case avrGetDCellBaud:
+			RobotSend(avrGetDCellBaud, dcellBaud);
+			break;
+		case avrGetAcquireMode:
+			RobotSend(avrGetAcquireMode, acquireMode);
+			break;
+		case avrGetDataFormat:
+			RobotSend(avrGetDataFormat, dataFormat);
+			break;
+		case avrGetBatchSize:
+			RobotSend(avrGetBatchSize, batchSize);
+			break;
+		case avrGetBatchFlush:
+			RobotSend(avrGetBatchFlush, batchFlush);
+			break;
+		case avrGetSampleDepth:
+			RobotSend(avrGetSampleDepth, (byte)(sampleHead - sampleTail));
+			break;
+		case avrGetSampleHighWater:
+			RobotSend(avrGetSampleHighWater, sampleHighWater);
+			break;
 	}
 	currentTask = ' ';
 }
@@ -1301,15 +2020,15 @@ void GetParamCnc(void)
 			switch (currentTask)
 			{
 			case avrGetHomeState:
-				homeState = atol(&fromCnc[2]);
+				homeState = cncReplyValue;
 				RobotSend(avrGetHomeState, homeState);
 				break;
 			case avrGetEnable:
-				motorEnable = atol(&fromCnc[2]);
+				motorEnable = cncReplyValue;
 				RobotSend(avrGetEnable, motorEnable);
 				break;
 			case avrIsRefHomed:
-				isRefHomed = atol(&fromCnc[2]);
+				isRefHomed = cncReplyValue;
 				RobotSend(avrIsRefHomed, isRefHomed);
 				break;
 			}
@@ -1399,10 +2118,219 @@ void SetParamAvr(int16_t newParam)
 		safeDisconnect = newParam;
 		RobotSend(avrGetSafeDisconnect, safeDisconnect);
 		break;
+	case avrSetSampleFields:
+		if (newParam < 0 || newParam > dcFieldAll)
+			ThrowError(ERR_PARAMETER, avrSetSampleFields);
+		else
+		{
+			sampleFields = newParam;
+			CreateForcePacket();
+			RobotSend(avrGetSampleFields, sampleFields);
+		}
+		break;
+	case avrSetDataFormat:
+		if (newParam < dfAscii || newParam > DATA_FORMAT_MAX)
+			ThrowError(ERR_PARAMETER, avrSetDataFormat);
+		else
+		{
+			RobotFlushBatch();
+			dataFormat = newParam;
+			forceSequence = 0;
+			RobotSend(avrGetDataFormat, dataFormat);
+		}
+		break;
+	case avrSetBatchSize:
+		if (newParam < 1 || newParam > BATCH_MAX)
+			ThrowError(ERR_PARAMETER, avrSetBatchSize);
+		else
+		{
+			RobotFlushBatch();
+			batchSize = newParam;
+			RobotSend(avrGetBatchSize, batchSize);
+		}
+		break;
+	case avrSetBatchFlush:
+		if (newParam < 1 || newParam > BATCH_FLUSH_MAX)
+			ThrowError(ERR_PARAMETER, avrSetBatchFlush);
+		else
+		{
+			batchFlush = newParam;
+			batchFlushTicks = MS_TO_TICKS(batchFlush);
+			RobotSend(avrGetBatchFlush, batchFlush);
+		}
+		break;
+	}
+	currentTask = ' ';
+}
+
+// Gives a parameter by its place in the avrGetBulk / avrSetBulk order
+long BulkParam(byte index)
+{
+	switch (index)
+	{
+	case 0:
+		return groundLevel;
+	case 1:
+		return maxDepth;
+	case 2:
+		return LFDtolerance;
+	case 3:
+		return maxForce;
+	case 4:
+		return minForce;
+	case 5:
+		return maxForceDelta;
+	case 6:
+		return minForceDelta;
+	case 7:
+		return forceDeltaAbs;
+	case 8:
+		return safeDisconnect;
+	case 9:
+		return sampleFields;
+	case 10:
+		return topSpeed;
+	case 11:
+		return speed;
+	case 12:
+		return homeSpeed;
+	case 13:
+		return acceleration;
+	case 14:
+		return deceleration;
+	case 15:
+		return stepsPerX;
+	}
+	return 0;
+}
+
+// Sends every parameter in one line, ?<value>,<value>... in BulkParam order
+void GetBulk(void)
+{
+	RobotTransmit(avrGetBulkString);
+	for (byte i = 0; i < BULK_PARAM_COUNT; i++)
+	{
+		if (i)
+			RobotTransmit(avrDataSeparatorString);
+		FormatLong(toRobot, BulkParam(i));
+		RobotTransmit(toRobot);
 	}
+	RobotTransmit(avrEoLString);
 	currentTask = ' ';
 }
 
+// Sends Cnc the parameters an avrSetBulk changes: the new values, or with restore the ones they replace
+void SetBulkCnc(byte restore)
+{
+	long* p = bulkParams;
+	if (p[10] != topSpeed)
+		CncSendRequest(cmdSetTopSpeed, ConvertMMtoSteps(restore ? topSpeed : p[10]), cncSlotTask);
+	if (p[11] != speed)
+		CncSendRequest(cmdSetSpeed, ConvertMMtoSteps(restore ? speed : p[11]), cncSlotTask);
+	if (p[12] != homeSpeed)
+		CncSendRequest(cmdSetHomeSpeed, ConvertMMtoSteps(restore ? homeSpeed : p[12]), cncSlotTask);
+	if (p[13] != acceleration)
+		CncSendRequest(cmdSetAccel, ConvertMMtoSteps(restore ? acceleration : p[13]), cncSlotTask);
+	if (p[14] != deceleration)
+		CncSendRequest(cmdSetDecel, ConvertMMtoSteps(restore ? deceleration : p[14]), cncSlotTask);
+	if (p[15] != stepsPerX)
+		CncSendRequest(cmdSetStepsPerM, ConvertDMMtoSteps(restore ? stepsPerX : p[15]), cncSlotTask);
+}
+
+// Sets every parameter from one line, =<value>,<value>... in BulkParam order, and answers as GetBulk
+// Every value is checked, against the new values of the others, before any is sent; the Cnc ones that
+// have changed then go all at once, and nothing is changed on the AVR until Cnc has accepted all of
+// them. If Cnc refuses any, the ones it took are put back and the whole line fails
+void SetBulk(void)
+{
+	long* p = bulkParams;
+	switch (currentStep)
+	{
+	case 0:
+	{
+		char* text = &robotCommand[1];
+		char* end;
+		byte valid = 1;
+		for (byte i = 0; i < BULK_PARAM_COUNT && valid; i++)
+		{
+			bulkParams[i] = strtol(text, &end, 10);
+			valid = end != text && *end == (i < BULK_PARAM_COUNT - 1 ? avrDataSeparator : avrEoL);
+			text = end + 1;
+		}
+		if (!valid
+			|| p[1] + p[0] < posMin || p[1] + p[0] > posMax
+			|| p[2] > TOLER_MAX || p[2] < TOLER_MIN
+			|| p[3] > FORCE_MAX || p[3] < p[4]
+			|| p[4] < FORCE_MIN
+			|| p[5] > FORCE_MAX || p[5] < p[4]
+			|| p[6] > p[3] || p[6] < FORCE_MIN
+			|| p[9] < 0 || p[9] > dcFieldAll
+			|| p[10] > speedMax || p[10] < 0
+			|| p[11] > p[10] || p[11] < 0
+			|| p[12] > p[10] || p[12] < 0
+			|| p[13] > accMax || p[13] < 0
+			|| p[14] > accMax || p[14] < 0
+			|| p[15] > STEPS_MAX || p[15] < STEPS_MIN)
+		{
+			ThrowError(ERR_PARAMETER, avrSetBulk);
+			return;
+		}
+		bulkRefused = 0;
+		SetBulkCnc(0);
+		currentStep++;
+		break;
+	}
+	case 1:
+		if (fromCncReady)
+		{
+			if (cncReplyCode == cncErrParameter || cncReplyCode == cncErrState)
+				bulkRefused = 1;
+			fromCncReady = 0;
+		}
+		if (CncWaiting())
+			break;
+		if (bulkRefused)
+		{
+			SetBulkCnc(1);
+			currentStep++;
+			break;
+		}
+		// Cnc has any new values but has not saved them, so a snapshot would not survive a reset of it
+		if (topSpeed != p[10] || speed != p[11] || homeSpeed != p[12] || acceleration != p[13] || deceleration != p[14] || stepsPerX != p[15])
+			CncSnapshotInvalidate();
+		groundLevel = p[0];
+		maxDepth = p[1];
+		LFDtolerance = p[2];
+		LFDcount = LFDtolerance;
+		maxForce = p[3];
+		minForce = p[4];
+		maxForceDelta = p[5];
+		minForceDelta = p[6];
+		forceDeltaAbs = p[7] != 0;
+		safeDisconnect = p[8] != 0;
+		if (sampleFields != p[9])
+		{
+			sampleFields = p[9];
+			CreateForcePacket();
+		}
+		topSpeed = p[10];
+		speed = p[11];
+		homeSpeed = p[12];
+		acceleration = p[13];
+		deceleration = p[14];
+		stepsPerX = p[15];
+		GetBulk();
+		break;
+	case 2:
+		// putting back what Cnc took before the refusal
+		fromCncReady = 0;
+		if (CncWaiting())
+			break;
+		ThrowError(ERR_PARAMETER, avrSetBulk);
+		break;
+	}
+}
+
 void SetParamCnc(word newParam)
 {
 	switch (currentStep)
@@ -1491,6 +2419,9 @@ void SetParamCnc(word newParam)
 				RobotSend(avrGetEnable, motorEnable);
 				break;
 			}
+			// Cnc has the new value but has not saved it, so a snapshot would not survive a reset of it
+			if (currentTask != avrSetEnable)
+				CncSnapshotInvalidate();
 			currentTask = ' ';
 		}
 	}
@@ -1498,22 +2429,67 @@ void SetParamCnc(word newParam)
 
 void GetForce(void)
 {
-	if (IsMoving())
+	if (currentStep == 0 && IsMoving())
 	{
-		int tempForce = currentForce;
+		long tempForce = currentForce;
 		while (tempForce != currentForce)
 			tempForce = currentForce;
-		RobotSend(avrGetForce, tempForce);
+		RobotSend(avrGetForce, FORCE_TO_N(tempForce));
+		currentTask = ' ';
+	}
+	else if (currentStep == 0)
+	{
+		// the first reading can be stale, so a second is taken GET_FORCE_DELAY after it is answered
+		DCellRequestForce();
+		currentStep++;
+	}
+	else if (waitingForDCell)
+		return;
+	else if (currentStep == 1)
+	{
+		if (GetTick() - fromDCellTime > MS_TO_TICKS(GET_FORCE_DELAY))
+		{
+			DCellRequestForce();
+			currentStep++;
+		}
 	}
 	else
 	{
-		DCellGetForce();
-		_delay_ms(2);
-		DCellGetForce();
 		ConvertForceToInt();
-		RobotSend(avrGetForce, currentForce);
+		RobotSend(avrGetForce, FORCE_TO_N(currentForce));
+		currentTask = ' ';
 	}
-	currentTask = ' ';
+}
+
+// Makes a line from the robot the current task
+void RobotStartCommand(char* line, byte tagged, word sequence)
+{
+	if (robotTagged) // an EStop or ping has cut the tagged task short
+		RobotCommandDone();
+	if (line[0] == avrNone)
+		RobotTransmit(avrPing);
+	else if (logging)
+	{
+		robot_puts("# Setting task to ");
+		robot_putc(line[0]);
+		robot_putc(avrEoL);
+	}
+	strcpy(robotCommand, line);
+	currentTask = line[0];
+	currentParameter = atol(&line[1]);
+	currentStep = 0;
+	robotTagged = tagged;
+	robotSequence = sequence;
+}
+
+// Tells the robot the tagged task has finished, after whatever it sent itself
+void RobotCommandDone(void)
+{
+	RobotTransmit(avrTagString);
+	FormatUnsigned(toRobot, robotSequence);
+	RobotTransmit(toRobot);
+	RobotTransmit(avrEoLString);
+	robotTagged = 0;
 }
 
 // Read from robot and react as necessary
@@ -1523,22 +2499,27 @@ void RobotListen(void)
 	if (fromRobotReady)
 	{
 		fromRobotReady = 0;
-		if (currentTask == avrNone || fromRobot[0] == avrSetEStop || fromRobot[0] == avrNone)
+		char* line = fromRobot;
+		byte tagged = 0;
+		word sequence = 0;
+		if (fromRobot[0] == avrTag)
 		{
-			if (fromRobot[0] == avrNone)
-				RobotTransmit(avrPing);
-			else if (logging)
-			{
-				robot_puts("# Setting task to ");
-				robot_putc(fromRobot[0]);
-				robot_putc(avrEoL);
-			}
-			currentTask = fromRobot[0];
-			currentParameter = atol(&fromRobot[1]);
-			currentStep = 0;
+			char* separator = strchr(fromRobot, avrDataSeparator);
+			tagged = 1;
+			sequence = atol(&fromRobot[1]);
+			line = separator ? separator + 1 : &fromRobot[1];
+		}
+		if (currentTask == avrNone || line[0] == avrSetEStop || line[0] == avrNone)
+			RobotStartCommand(line, tagged, sequence);
+		else if (tagged && (byte)(robotQueueHead - robotQueueTail) < ROBOT_QUEUE_SIZE)
+		{
+			byte slot = robotQueueHead & ROBOT_QUEUE_MASK;
+			strcpy(robotQueueLine[slot], line);
+			robotQueueSequence[slot] = sequence;
+			robotQueueHead++;
 		}
 		else
-			ThrowError(ERR_BUSY, fromRobot[0]);
+			ThrowError(ERR_BUSY, line[0]);
 	}
 	switch(currentTask)
 	{
@@ -1573,6 +2554,13 @@ void RobotListen(void)
 	case avrDCellPassthrough:
 		DCellPassthrough();
 		break;
+	case avrFetchProfile:
+		FetchProfile(currentParameter);
+		break;
+	case avrGetProfileCount:
+		RobotSend(avrGetProfileCount, ProfileCount());
+		currentTask = ' ';
+		break;
 	default:
 		if (errorNum || estop)
 			GetErrorEstop();
@@ -1592,6 +2580,8 @@ void RobotListen(void)
 		case avrGetEnable:
 		case avrCncPassthrough:
 		case avrDCellPassthrough:
+		case avrFetchProfile:
+		case avrGetProfileCount:
 			break;
 		case avrDone:
 			Done();
@@ -1608,6 +2598,12 @@ void RobotListen(void)
 		case avrDoRefHome:
 			DoRefHome();
 			break;
+		case avrSetDCellBaud:
+			SetDCellBaud(currentParameter);
+			break;
+		case avrSetAcquireMode:
+			SetAcquireMode(currentParameter);
+			break;
 		case avrSetGroundLevel:
 		case avrSetProbeDepth:
 		case avrSetLFDTolerance:
@@ -1617,8 +2613,18 @@ void RobotListen(void)
 		case avrSetMinForceDelta:
 		case avrSetForceDeltaAbs:
 		case avrSetSafeDisconnect:
+		case avrSetSampleFields:
+		case avrSetDataFormat:
+		case avrSetBatchSize:
+		case avrSetBatchFlush:
 			SetParamAvr(currentParameter);
 			break;
+		case avrSetBulk:
+			SetBulk();
+			break;
+		case avrGetBulk:
+			GetBulk();
+			break;
 		case avrSetTopSpeed:
 		case avrSetSpeed:
 		case avrSetHomeSpeed:
@@ -1645,6 +2651,17 @@ void RobotListen(void)
 		case avrGetSafeDisconnect:
 		case avrGetLFDState:
 		case avrGetProbeState:
+		case avrGetSampleFields:
+		case avrGetDCellStatus:
+		case avrGetDCellTemp:
+		case avrGetDCellFlags:
+		case avrGetDCellBaud:
+		case avrGetAcquireMode:
+		case avrGetDataFormat:
+		case avrGetBatchSize:
+		case avrGetBatchFlush:
+		case avrGetSampleDepth:
+		case avrGetSampleHighWater:
 			GetParamAvr();
 			break;
 		case avrGetHomeState:
@@ -1659,6 +2676,18 @@ void RobotListen(void)
 			break;
 		}
 	}
+	if (currentTask == avrNone)
+	{
+		if (robotTagged)
+			RobotCommandDone();
+		// the next queued command starts now, so a new line next time waits its turn behind it
+		if (robotQueueHead != robotQueueTail)
+		{
+			byte slot = robotQueueTail & ROBOT_QUEUE_MASK;
+			RobotStartCommand(robotQueueLine[slot], 1, robotQueueSequence[slot]);
+			robotQueueTail++;
+		}
+	}
 }
 
 // *** Internal operations
@@ -1670,6 +2699,37 @@ void DoSafeRefHome(byte newErrorNum, char newErrorParam)
 	DoEStop(newErrorNum, newErrorParam);
 }
 
+// Sends logged events to the robot, one at a time and only when the whole line fits in the
+// transmit buffer, so logging never holds up the main loop either
+void LogDrain(void)
+{
+	byte id;
+	dword time;
+	word payload;
+	if (robot_tx_free() < LOG_LINE_MAX)
+		return;
+	word dropped = EventLogTakeDropped();
+	if (dropped)
+	{
+		robot_puts("# ");
+		FormatUnsigned(toRobot, dropped);
+		robot_puts(toRobot);
+		robot_puts(" log events dropped\n");
+	}
+	else if (EventLogTake(&id, &time, &payload))
+	{
+		robot_puts("# ");
+		robot_puts(EventLogText(id));
+		robot_putc(' ');
+		FormatUnsigned(toRobot, payload);
+		robot_puts(toRobot);
+		robot_puts(" @");
+		FormatUnsigned(toRobot, time);
+		robot_puts(toRobot);
+		robot_putc(avrEoL);
+	}
+}
+
 void DoEStop(byte newErrorNum, char newErrorParam)
 {
 	errorNum = newErrorNum;
@@ -1677,7 +2737,7 @@ void DoEStop(byte newErrorNum, char newErrorParam)
 	estop = 1;
 	SetPinDir(port_Estop, pin_Estop, dirOutput);
 	if (logging)
-		robot_puts("# EStop thrown\n");
+		EventLog(evEStopThrown, GetTick(), ((word)newErrorNum << 8) | (byte)newErrorParam);
 }
 
 void ISRInit(void)
@@ -1697,6 +2757,7 @@ void TimerInit(void)
 ISR(ISR_Tick)
 {
 	tick++;
+	DCellTick();
 	if (robotWatchdog > 0)
 	{
 		robotWatchdog--;
@@ -1724,19 +2785,25 @@ ISR(ISR_DoSample)
 			sampleCount += stepsPerX;
 		else
 			sampleCount -= stepsPerX;
-		if (readSample)
+		byte head = sampleHead;
+		byte slot = head & SAMPLE_QUEUE_MASK;
+		byte depth = head + 1 - sampleTail;
+		if (depth > SAMPLE_QUEUE_SIZE)
 		{
 			if (logging)
-				robot_puts("# DCell slow sample\n");
+				EventLog(evDCellSlowSample, tick, depth - 1);
 			DoEStop(ERR_NO_COMMS, avrErrDCell);
 		}
+		// when streaming the latest reading is latched with the step count; otherwise DCell is asked for one
+		else if (acquireMode ? !DCellLatestSample(sampleValue[slot]) : !DCellQueue(forcePacket, 8, dcTagSample))
+			DoEStop(ERR_NO_COMMS, avrErrDCell);
 		else
 		{
-			readSample = 1;
-			for (byte i = 0; i < 8; i++)
-				toDCell[i] = forcePacket[i];
-			toDCellLength = 8;
-			DCellTransmit();
+			samplePosition[slot] = sampleCount;
+			sampleTime[slot] = tick;
+			sampleHead = head + 1;
+			if (depth > sampleHighWater)
+				sampleHighWater = depth;
 		}
 	}
 }
@@ -1748,10 +2815,10 @@ ISR(ISR_Estop)
 	isHoming = 0;
 	isProbing = 0;
 	waitingForRobot = 0;
-	waitingForCnc = 0;
-	waitingForDCell = 0;
+	sampleTail = sampleHead - DCellFlush(); // keeping only a sample whose reply is still coming
+	waitingForDCell = 0; // nothing it was counting will come back now
 	if (logging)
-		robot_puts("# ISR Estop thrown\n");
+		EventLog(evIsrEStop, tick, 0);
 }
 
 int main(void)
@@ -1767,6 +2834,7 @@ int main(void)
 	Uart0SetFormat(umoAsync, udb8, upaNone, ust1);
 	Uart1SetFormat(umoAsync, udb8, upaNone, ust1);   // Asynchronous mode, 8 data bits, no parity, 1 stop bit
 	Uart2SetFormat(umoAsync, udb8, upaNone, ust1);
+	DCellRtuTiming(BAUD);
 	Uart0FlushRxBuffer();
 	Uart1FlushRxBuffer();
 	Uart2FlushRxBuffer();
@@ -1775,6 +2843,7 @@ int main(void)
 	SetPin(port_Estop, pin_Estop, Lo);
 	SetPinDir(port_LFD, pin_LFD, dirInput);
 	SetPinPullUp(port_LFD, pin_LFD, swOn);
+	AvrParamsLoad();
 	ISRInit();
 	TimerInit();
 	sei();
@@ -1792,11 +2861,12 @@ int main(void)
 		if (newestop)
 		{
 			newestop = 0;
+			CncCancelAll(); // the replies to anything in flight no longer matter
 			if (errorNum == 0)
 			{
 				CncGetFault();
 				CncReadLine();
-				motorFault = atol(&fromCnc[2]);
+				motorFault = cncReplyValue;
 				if (motorFault)
 				{
 					errorNum = ERR_HARDWARE_FAULT;
@@ -1806,7 +2876,7 @@ int main(void)
 				{
 					CncGetHomeState();
 					CncReadLine();
-					homeState = atol(&fromCnc[2]);
+					homeState = cncReplyValue;
 					switch (homeState)
 					{
 					case cncHsMinLimit:
@@ -1826,5 +2896,7 @@ int main(void)
 		RobotListen();
 		CncListen();
 		DCellListen();
+		RobotBatchTimer();
+		LogDrain();
 	}
 }
\ No newline at end of file
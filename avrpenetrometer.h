@@ -34,6 +34,7 @@
 #define cncErrHardware '5'
 #define cncErrState '6'
 #define cncErrComms '7'
+#define CncIsError(c) ((c) >= cncErrConstrained && (c) <= cncErrComms) // cncErr... are '/' to '7'
 
 #define STEPS_PER_DMM 32
 #define STEPS_PER_MM 320
@@ -44,9 +45,95 @@
 #define TOLER_MIN 0
 #define FORCE_MAX 10000
 #define FORCE_MIN -10000
+
+// Forces are kept in fixed point, N * 2^FORCE_FRAC_BITS; 10 bits gives about 1mN and up to 2,000,000N
+#ifndef FORCE_FRAC_BITS
+	#define FORCE_FRAC_BITS 10
+#endif
+#define FORCE_ONE (1L << FORCE_FRAC_BITS)
+#define FORCE_FROM_N(n) ((long)(n) << FORCE_FRAC_BITS)
+#define FORCE_TO_N(f) (((f) + FORCE_ONE / 2) >> FORCE_FRAC_BITS) // rounded to nearest
+
+// Decimal places of force sent to the robot with each sample, 0 to 4; 0 keeps whole Newtons
+#ifndef ROBOT_FORCE_DECIMALS
+	#define ROBOT_FORCE_DECIMALS 0
+#endif
+#if ROBOT_FORCE_DECIMALS == 1
+	#define ROBOT_FORCE_SCALE 10
+#elif ROBOT_FORCE_DECIMALS == 2
+	#define ROBOT_FORCE_SCALE 100
+#elif ROBOT_FORCE_DECIMALS == 3
+	#define ROBOT_FORCE_SCALE 1000
+#elif ROBOT_FORCE_DECIMALS == 4
+	#define ROBOT_FORCE_SCALE 10000
+#endif
+
+// Formats force data can be sent to the robot in (avrSetDataFormat)
+#define dfAscii 0 // *<position>,<force>\n lines, the default
+#define dfSlip 1 // SLIP framed binary, see RobotForceFrame
+#define dfStore 2 // nothing sent while probing; the robot fetches the profile afterwards
+#define dfDelta 3 // SLIP framed varint deltas, see RobotDeltaFrame
+#define DATA_FORMAT_MAX dfDelta
+#define PROFILE_LINE_MAX 32 // longest line FetchProfile sends for one sample
+#define PROFILE_CHUNK 4 // samples in each dfDelta frame FetchProfile sends
+#define PROFILE_FRAME_MAX (2 * (5 + PROFILE_CHUNK * (2 * VARINT_MAX + 1)) + 2) // if every byte were escaped
+#define FORCE_FRAME_SIZE 8 // sequence, position change, force and CRC, before SLIP escaping
+#define FORCE_KEY_FRAME_SIZE 10 // sequence, position, force and CRC
+#define FRAME_FORCE_FRAC_BITS 8 // forces in dfSlip frames are 3 bytes, N * 2^8, up to 32767N
+#if FORCE_FRAC_BITS < FRAME_FORCE_FRAC_BITS
+	#error FORCE_FRAC_BITS is below FRAME_FORCE_FRAC_BITS
+#endif
+#define SLIP_END 0xC0
+#define SLIP_ESC 0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+// Samples can be batched, so the robot gets one message for several of them (avrSetBatchSize)
+#define BATCH_MAX 8 // most samples in one batch
+#define BATCH_FLUSH_DEFAULT 50 // ms a batch can wait before it is sent part full
+#define BATCH_FLUSH_MAX 1000
 #define ROBOT_TIMEOUT 3000
 #define CNC_TIMEOUT 100
-#define DCELL_TIMEOUT 100
+#define CNC_PENDING_SIZE 16 // requests that can be sent to Cnc before their replies come back
+
+// What is done with the reply to a Cnc request (CncRequest)
+#define cncSlotTask 0 // left in fromCnc for the running task, with fromCncReady set
+#define cncSlotStore 1 // stored by CncStoreParam
+#define cncSlotNone 0xFF // not the reply to any request
+
+// cncReplyFlags, set by CncParseReply
+#define cncReplyHasValue 0x01 // there were digits after the axis
+#define cncReplyNegative 0x02 // the value had a minus sign
+
+// The parameters synchronised from Cnc are kept in EEPROM while they match what Cnc has saved,
+// so Init only has to check a few of them; change the version if the layout changes
+#define CNC_SNAPSHOT_VERSION 2
+#define CNC_SNAPSHOT_COUNT 10
+#define CNC_SNAPSHOT_CHECKS 5 // parameters Init reads to check the snapshot, see CncSnapshotQuery
+
+// The AVR's own parameters are saved to EEPROM along with Cnc's, and loaded again at reset;
+// change the version if the layout changes
+#define AVR_PARAMS_VERSION 1
+#define AVR_PARAMS_COUNT 9
+
+// Parameters read and written all at once by avrGetBulk and avrSetBulk, in this order:
+// groundLevel, maxDepth, LFDtolerance, maxForce, minForce, maxForceDelta, minForceDelta,
+// forceDeltaAbs, safeDisconnect, sampleFields, topSpeed, speed, homeSpeed, acceleration,
+// deceleration, stepsPerX
+#define BULK_PARAM_COUNT 16
+#define BULK_PARAM_CNC 10 // the rest are on Cnc
+
+#define ROBOT_LINE_MAX 128 // longest line taken from the robot, room for an avrSetBulk
+
+// Commands tagged &<sequence>,<command> are queued if another is running, rather than refused,
+// and &<sequence> is sent once each has finished
+#define ROBOT_QUEUE_SIZE 4 // tagged commands that can wait, must be a power of 2
+#define ROBOT_QUEUE_MASK (ROBOT_QUEUE_SIZE - 1)
+#define SAMPLE_QUEUE_SIZE 8 // samples that can be waiting for the main loop, must be a power of 2
+#define SAMPLE_QUEUE_MASK (SAMPLE_QUEUE_SIZE - 1)
+#define SAMPLE_MAX_AGE 100 // ticks a sample can wait before it is too late to act on
+#define GET_FORCE_DELAY 2 // ms between the answer to GetForce's first reading and its second
+#define LOG_LINE_MAX 48 // longest line LogDrain sends for one event
 
 #define STATION_NUMBER 1
 
@@ -150,6 +237,11 @@
 #define avrDoProbe '!'
 #define avrData '*'
 #define avrDataSeparator ','
+#define avrBatch '+'
+#define avrFetchProfile '.'
+#define avrSetBulk '='
+#define avrTag '&'
+#define avrGetBulk '?'
 #define avrDoRefHome 'z'
 
 #define avrSetEStop 'e'
@@ -173,6 +265,12 @@
 #define avrSetHomeState 'h'
 #define avrSetLFDState 'u'
 #define avrSetProbeState 'j'
+#define avrSetSampleFields 'i'
+#define avrSetDCellBaud '%'
+#define avrSetAcquireMode '('
+#define avrSetDataFormat '{'
+#define avrSetBatchSize '<'
+#define avrSetBatchFlush ':'
 #define avrSetError 'f'
 #define avrCncPassthrough 'b'
 #define avrDCellPassthrough 'c'
@@ -199,6 +297,18 @@
 #define avrGetHomeState 'H'
 #define avrGetLFDState 'U'
 #define avrGetProbeState 'J'
+#define avrGetSampleFields 'I'
+#define avrGetDCellStatus 'C'
+#define avrGetDCellTemp '$'
+#define avrGetDCellFlags '|'
+#define avrGetDCellBaud 'B'
+#define avrGetAcquireMode ')'
+#define avrGetDataFormat '}'
+#define avrGetBatchSize '>'
+#define avrGetBatchFlush ';'
+#define avrGetProfileCount '_'
+#define avrGetSampleDepth '['
+#define avrGetSampleHighWater ']'
 #define avrGetError 'F'
 
 #define avrNoneString " "
@@ -209,6 +319,11 @@
 #define avrDoProbeString "!"
 #define avrDataString "*"
 #define avrDataSeparatorString ","
+#define avrBatchString "+"
+#define avrFetchProfileString "."
+#define avrSetBulkString "="
+#define avrTagString "&"
+#define avrGetBulkString "?"
 #define avrDoRefHomeString "z"
 
 #define avrSetEStopString "e"
@@ -232,6 +347,12 @@
 #define avrSetHomeStateString "h"
 #define avrSetLFDStateString "u"
 #define avrSetErrorString "f"
+#define avrSetSampleFieldsString "i"
+#define avrSetDCellBaudString "%"
+#define avrSetAcquireModeString "("
+#define avrSetDataFormatString "{"
+#define avrSetBatchSizeString "<"
+#define avrSetBatchFlushString ":"
 #define avrCncPassthroughString "b"
 #define avrDCellPassthroughString "c"
 
@@ -257,11 +378,25 @@
 #define avrGetHomeStateString "H"
 #define avrGetLFDStateString "U"
 #define avrGetErrorString "F"
+#define avrGetSampleFieldsString "I"
+#define avrGetDCellStatusString "C"
+#define avrGetDCellTempString "$"
+#define avrGetDCellFlagsString "|"
+#define avrGetDCellBaudString "B"
+#define avrGetAcquireModeString ")"
+#define avrGetDataFormatString "}"
+#define avrGetBatchSizeString ">"
+#define avrGetBatchFlushString ";"
+#define avrGetProfileCountString "_"
+#define avrGetSampleDepthString "["
+#define avrGetSampleHighWaterString "]"
 
 #define avrPing avrNoneString avrEoLString
 
 #define cnc_getc		uart1_getc
 #define cnc_gets		uart1_gets
+#define cnc_getline	uart1_getline
+#define cnc_getbytes	uart1_getbytes
 #define cnc_putbytes	uart1_putbytes
 #define cnc_putc		uart1_putc
 #define cnc_puts		uart1_puts
@@ -274,9 +409,12 @@
 
 #define robot_getc		uart0_getc
 #define robot_gets		uart0_gets
+#define robot_getline	uart0_getline
+#define robot_getbytes	uart0_getbytes
 #define robot_putbytes	uart0_putbytes
 #define robot_putc		uart0_putc
 #define robot_puts		uart0_puts
+#define robot_tx_free	uart0_tx_free
 
 #define port_IsMoving	PORTJ
 #define pin_IsMoving	PJ0
@@ -307,37 +445,71 @@
 
 #define T1_COUNT 20000
 #define T1_PRESCALE ((0 << CS12) | (0 << CS11) | (1 << CS10) | (1 << WGM13) | (1 << WGM12))
+#define TICK_US (T1_COUNT / (F_CPU / 1000000UL)) // Timer1 is not prescaled
+#define MS_TO_TICKS(ms) (((dword)(ms) * 1000 + TICK_US - 1) / TICK_US) // rounded up
 
-byte TxWait(void);
 dword GetTick(void);
 boolean IsMoving(void);
 
 void DCellTransmit(void);
-void DCellReadChar(void);
+void DCellTransmitCheck(void);
 void DCellSetChecksum(void);
-byte DCellVerifyChecksum(void);
 void DCellReadPacket(void);
-void DCellReadCommand(word startRegister);
-void DCellWriteCommand(word startRegister, word lowerRegister, word upperRegister);
-void DCellFlush(void);
+void DCellCreateRead(word startRegister);
+void DCellRequestRead(word startRegister);
+void DCellCreateWrite(word startRegister, word lowerRegister, word upperRegister);
+void DCellRequestWrite(word startRegister, word lowerRegister, word upperRegister);
 void CreateForcePacket(void);
-void DCellGetForce(void);
-void DCellGetStationNumber(void);
+byte DCellFieldOffset(word reg);
+void DCellDecodeSample(void);
+void DCellRequestForce(void);
 void DCellListen(void);
+word DCellBaudUbrr(byte code);
+byte DCellSetBaud(byte code);
+void SetDCellBaud(byte newBaud);
+void SetAcquireMode(int16_t newMode);
+void CheckSample(byte slot);
+void CheckForce(long position);
 void DCellPassthrough(void);
 
 long ConvertDMMtoSteps(long inValue);
-long ConvertStepstoDMM(char* inString);
+long ConvertStepstoDMM(long inValue);
 long ConvertMMtoSteps(long inValue);
-long ConvertStepstoMM(char* inString);
+long ConvertStepstoMM(long inValue);
+void ConvertForce(const char* value);
 void ConvertForceToInt(void);
+byte FormatForce(long force, char* text);
 
 void CncTransmit(char* line);
 void CncReadChar(void);
+void CncParseReply(void);
 void CncSend(char cmd, long parameter);
 void CncReadLine(void);
 void CncFlush(void);
 void CncInit(void);
+void CncRequest(const char* line, char rsp, word timeout, byte slot);
+void CncQuery(const char* line, char rsp);
+byte CncTakeReply(void);
+byte CncWaiting(void);
+void CncRemoveRequest(byte i);
+void CncCheckTimeouts(void);
+void CncCancelAll(void);
+void CncSnapshotSave(void);
+byte CncSnapshotLoad(void);
+void CncSnapshotInvalidate(void);
+void CncSnapshotQuery(void);
+byte CncSnapshotMatches(void);
+void CncSyncParams(void);
+void AvrParamsSave(void);
+void CncSendRequest(char cmd, long parameter, byte slot);
+long BulkParam(byte index);
+void GetBulk(void);
+void RobotStartCommand(char* line, byte tagged, word sequence);
+void RobotCommandDone(void);
+void SetBulkCnc(byte restore);
+void SetBulk(void);
+byte AvrParamsLoad(void);
+void CncStoreParam(char rsp, long value);
 void CncDone(void);
 void CncSaveParams(void);
 void CncSetEStop(void);
@@ -385,7 +557,17 @@ void CncPassthrough(void);
 void RobotTransmit(char* line);
 void RobotReadChar(void);
 void RobotSend(char cmd, word parameter);
-void RobotForceData(void);
+void RobotSendUnsigned(char cmd, word parameter);
+void RobotForceData(long position);
+void RobotForceFrame(long position);
+byte FramePutForce(char* out, long force);
+void RobotSlipSend(const char* frame, byte length);
+void RobotBatchForce(long position);
+void RobotFlushBatch(void);
+void RobotBatchTimer(void);
+void FetchProfile(long start);
+void RobotDeltaFrame(long start, int step, const long* forces, byte count);
+void FetchProfileFrame(void);
 void Init(void);
 void Done(void);
 void Save(void);
@@ -406,6 +588,7 @@ void GetForce(void);
 void RobotListen(void);
 
 void DoSafeRefHome(byte newErrorNum, char newErrorParam);
+void LogDrain(void);
 void DoEStop(byte newErrorNum, char newErrorParam);
 void ISRInit(void);
 void TimerInit(void);
@@ -0,0 +1,46 @@
+/*
+ * DCellBaudTest.c
+ *
+ * Checks which MD_BAUD rates UART2 can be set to at this F_CPU (make F_CPU=...),
+ * using the same DCELL_UBRR and DCELL_BAUD_ERROR as DCellBaudUbrr, and prints them.
+ * At 16MHz the codes up to 6 (115200) are to be usable, and 7 (230400) not.
+ */
+
+#include <stdio.h>
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "DCell.h"
+
+// The rates of the MD_BAUD codes, as DCellBaudRate gives them
+static const dword rates[8] = { 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400 };
+
+int main(void)
+{
+	int failures = 0;
+	byte highest = 0;
+
+	printf("F_CPU %lu, U2X\n", (unsigned long)F_CPU);
+	for (byte code = 0; code < 8; code++)
+	{
+		dword rate = rates[code];
+		byte usable = DCELL_BAUD_ERROR(rate) <= DCELL_BAUD_ERROR_MAX;
+		printf("code %d %6lu baud: UBRR %3u gives %6lu, %+.2f%% %s\n", code, (unsigned long)rate, DCELL_UBRR(rate),
+			(unsigned long)DCELL_BAUD_ACTUAL(rate), 100.0 * ((double)DCELL_BAUD_ACTUAL(rate) - rate) / rate, usable ? "used" : "not used");
+		if (usable && highest == code)
+			highest = code + 1;
+	}
+	printf("Highest usable code %d (%lu baud)\n", highest - 1, (unsigned long)rates[highest - 1]);
+
+#if F_CPU == 16000000UL
+	if (highest != 7)
+	{
+		printf("At 16MHz codes 0 to 6 should be usable\n");
+		failures++;
+	}
+#endif
+
+	printf("DCellBaudTest: %s\n", failures ? "FAILED" : "ok");
+	return failures != 0;
+}
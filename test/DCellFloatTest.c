@@ -0,0 +1,95 @@
+/*
+ * DCellFloatTest.c
+ *
+ * Checks DCellFloatToFixed against the host's float sums, rounded to nearest, for
+ * every exponent with a spread of mantissas and both signs, at several numbers of
+ * fraction bits; then times it against the float sums it stands in for.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "DCellFloat.h"
+
+// Lays out a float the way DCell sends it: the low register first, each register high byte first
+static void PutFloat(char* value, float number)
+{
+	dword bits;
+	memcpy(&bits, &number, 4);
+	value[2] = bits >> 24;
+	value[3] = bits >> 16;
+	value[0] = bits >> 8;
+	value[1] = bits;
+}
+
+// What DCellFloatToFixed should give, worked out in floating point
+static long Reference(float number, byte fracBits, byte* flags)
+{
+	double scaled = fabs((double)number) * ldexp(1.0, fracBits);
+	*flags = 0;
+	if (isnan(number) || isinf(number) || scaled >= 2147483648.0)
+	{
+		*flags = FLOAT_SATURATED;
+		return signbit(number) ? -0x7FFFFFFFL : 0x7FFFFFFFL;
+	}
+	long result = (long)floor(scaled + 0.5);
+	if (result == 0 && number != 0 && fpclassify(number) != FP_SUBNORMAL)
+		*flags = FLOAT_UNDERFLOW;
+	return signbit(number) ? -result : result;
+}
+
+int main(void)
+{
+	static const byte fracBitsTried[] = { 0, 4, 10, 16 };
+	long checked = 0;
+	int failures = 0;
+
+	srand(1);
+	for (byte f = 0; f < sizeof(fracBitsTried); f++)
+		for (dword exponent = 0; exponent < 256; exponent++)
+			for (int i = 0; i < 4000; i++)
+			{
+				dword mantissa = i < 4 ? (dword[]){ 0, 1, 0x400000, 0x7FFFFF }[i] : (((dword)rand() << 8) ^ rand()) & 0x7FFFFF;
+				dword bits = ((dword)(i & 1) << 31) | (exponent << 23) | mantissa;
+				float number;
+				char value[4];
+				byte expectedFlags;
+				memcpy(&number, &bits, 4);
+				PutFloat(value, number);
+				long expected = Reference(number, fracBitsTried[f], &expectedFlags);
+				long result = DCellFloatToFixed(value, fracBitsTried[f]);
+				checked++;
+				if (result != expected || floatFlags != expectedFlags)
+				{
+					if (failures++ < 10)
+						printf("%g (0x%08lX) with %d fraction bits: %ld flags %d, expected %ld flags %d\n", number, (unsigned long)bits,
+							fracBitsTried[f], result, floatFlags, expected, expectedFlags);
+				}
+			}
+
+	char value[4];
+	volatile long sink = 0;
+	PutFloat(value, 1234.567f);
+	clock_t start = clock();
+	for (long i = 0; i < 20000000; i++)
+	{
+		value[1] = i;
+		sink += DCellFloatToFixed(value, 10);
+	}
+	double integerSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	volatile float number = 1234.567f;
+	start = clock();
+	for (long i = 0; i < 20000000; i++)
+		sink += lroundf(number * 1024.0f + i * 1e-9f);
+	double floatSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("DCellFloatToFixed %.2f ns, float sums %.2f ns, on the host\n", integerSeconds * 50, floatSeconds * 50);
+
+	printf("DCellFloatTest: %ld values, %s\n", checked, failures ? "FAILED" : "all match");
+	return failures != 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * EventLogTest.c
+ *
+ * Logs more events than the log holds and checks the first EVENT_LOG_SIZE come back
+ * in order, the rest are counted as dropped, and the log keeps working as it wraps
+ */
+
+#include <stdio.h>
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "EventLog.h"
+
+volatile uint8_t SREG;
+
+int main(void)
+{
+	int failures = 0;
+	byte id;
+	dword time;
+	word payload;
+
+	for (word round = 0; round < 40; round++)
+	{
+		byte logged = round % (EVENT_LOG_SIZE + 5) + 1;
+		for (byte i = 0; i < logged; i++)
+			EventLog(i % 3, round * 1000UL + i, round + i);
+		byte kept = logged < EVENT_LOG_SIZE ? logged : EVENT_LOG_SIZE;
+		for (byte i = 0; i < kept; i++)
+			if (!EventLogTake(&id, &time, &payload) || id != i % 3 || time != round * 1000UL + i || payload != round + i)
+			{
+				printf("round %u: event %d came back wrongly\n", round, i);
+				failures++;
+			}
+		if (EventLogTake(&id, &time, &payload))
+		{
+			printf("round %u: more events than were kept\n", round);
+			failures++;
+		}
+		word dropped = EventLogTakeDropped();
+		if (dropped != logged - kept || EventLogTakeDropped() != 0)
+		{
+			printf("round %u: %u dropped, expected %d\n", round, dropped, logged - kept);
+			failures++;
+		}
+	}
+
+	printf("EventLogTest: %s\n", failures ? "FAILED" : "ok");
+	return failures != 0;
+}
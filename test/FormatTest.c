@@ -0,0 +1,104 @@
+/*
+ * FormatTest.c
+ *
+ * Checks FormatLong and FormatUnsigned against sprintf (as ltoa and ultoa would write
+ * them) over the whole long range, every edge of every digit count and LONG_MIN, and
+ * FormatDigits for every value and width; then times them against sprintf
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "Format.h"
+
+static long checked = 0;
+static int failures = 0;
+
+static void CheckLong(int32_t value)
+{
+	char out[FORMAT_LONG_MAX + 2];
+	char expected[16];
+	memset(out, 'x', sizeof(out));
+	byte length = FormatLong(out, value);
+	sprintf(expected, "%ld", (long)value);
+	checked++;
+	if (length > FORMAT_LONG_MAX || length != strlen(expected) || strcmp(out, expected))
+	{
+		if (failures++ < 10)
+			printf("FormatLong %s: \"%.*s\" length %d\n", expected, FORMAT_LONG_MAX + 1, out, length);
+	}
+}
+
+static void CheckUnsigned(dword value)
+{
+	char out[FORMAT_LONG_MAX + 2];
+	char expected[16];
+	memset(out, 'x', sizeof(out));
+	byte length = FormatUnsigned(out, value);
+	sprintf(expected, "%lu", (unsigned long)value);
+	checked++;
+	if (length != strlen(expected) || strcmp(out, expected))
+	{
+		if (failures++ < 10)
+			printf("FormatUnsigned %s: \"%.*s\" length %d\n", expected, FORMAT_LONG_MAX + 1, out, length);
+	}
+}
+
+int main(void)
+{
+	for (int32_t value = -200000; value <= 200000; value++)
+		CheckLong(value);
+	for (int64_t power = 1; power <= 1000000000; power *= 10)
+		for (int64_t edge = power - 2; edge <= power + 1; edge++)
+		{
+			CheckLong(edge);
+			CheckLong(-edge);
+			CheckUnsigned(edge);
+			CheckUnsigned(edge * 4 > UINT32_MAX ? UINT32_MAX - edge : edge * 4);
+		}
+	for (int64_t value = INT32_MIN; value <= INT32_MAX; value += 4099)
+	{
+		CheckLong(value);
+		CheckUnsigned((dword)value);
+	}
+	CheckLong(INT32_MIN);
+	CheckLong(INT32_MIN + 1);
+	CheckLong(INT32_MAX);
+	CheckUnsigned(UINT32_MAX);
+	CheckUnsigned(0);
+
+	for (word value = 0; value < 10000; value++)
+		for (byte digits = 1; digits <= 4; digits++)
+		{
+			char out[6];
+			char expected[6];
+			byte length = FormatDigits(out, value, digits);
+			sprintf(expected, "%04u", value);
+			checked++;
+			if (length != digits || strcmp(out, &expected[4 - digits]))
+			{
+				if (failures++ < 10)
+					printf("FormatDigits %u, %d: \"%s\"\n", value, digits, out);
+			}
+		}
+
+	char out[16];
+	volatile long sink = 0;
+	clock_t start = clock();
+	for (long i = 0; i < 10000000; i++)
+		sink += FormatLong(out, (int32_t)(i * 2654435761u));
+	double formatSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	start = clock();
+	for (long i = 0; i < 10000000; i++)
+		sink += sprintf(out, "%ld", (long)(int32_t)(i * 2654435761u));
+	double sprintfSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("FormatLong %.1f ns, sprintf %.1f ns, on the host\n", formatSeconds * 100, sprintfSeconds * 100);
+
+	printf("FormatTest: %ld values, %s\n", checked, failures ? "FAILED" : "all match");
+	return failures != 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * ModbusCrcTest.c
+ *
+ * Checks the table, nibble and bitwise CRC engines in ModbusCrc.c agree with each
+ * other for every CRC and byte, and with the CRCs of known Modbus frames; then
+ * times them. Host times only show how the engines compare, not AVR cycles.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "ModbusCrc.h"
+
+word TableCrcUpdate(word crc, byte data);
+word TableCrc(const char* data, byte length);
+word NibbleCrcUpdate(word crc, byte data);
+word NibbleCrc(const char* data, byte length);
+word BitwiseCrcUpdate(word crc, byte data);
+word BitwiseCrc(const char* data, byte length);
+
+typedef word (*CrcFunction)(const char* data, byte length);
+
+static const CrcFunction engines[3] = { TableCrc, NibbleCrc, BitwiseCrc };
+static const char* engineNames[3] = { "table", "nibble", "bitwise" };
+
+// Frames as DCell sends and receives them, without their CRC, and the CRC they should have
+static const struct
+{
+	const char* frame;
+	byte length;
+	word crc;
+} knownFrames[] =
+{
+	{ "\x01\x03\x00\x00\x00\x0A", 6, 0xCDC5 }, // read 10 holding registers, the Modbus spec example
+	{ "\x01\x03\x00\x00\x00\x02", 6, 0x0BC4 }, // read of 2 registers
+	{ "\x01\x03\x04\x00\x00\x00\x00", 7, 0x33FA }, // a reply with 4 bytes of 0
+	{ "\x01\x10\x00\x44\x00\x02\x04\x00\x07\x00\x00", 11, 0xAD47 }, // write of MD_BAUD
+	{ "\x11\x03\x00\x6B\x00\x03", 6, 0x8776 },
+	{ "\x01\x04\x02\xFF\xFF", 5, 0x80B8 },
+};
+
+int main(void)
+{
+	int failures = 0;
+
+	for (dword crc = 0; crc <= 0xFFFF; crc++)
+		for (word data = 0; data <= 0xFF; data++)
+		{
+			word table = TableCrcUpdate(crc, data);
+			if (table != NibbleCrcUpdate(crc, data) || table != BitwiseCrcUpdate(crc, data))
+			{
+				if (failures++ < 10)
+					printf("ModbusCrcUpdate(0x%04X, 0x%02X): table 0x%04X nibble 0x%04X bitwise 0x%04X\n", (unsigned)crc, data,
+						table, NibbleCrcUpdate(crc, data), BitwiseCrcUpdate(crc, data));
+			}
+		}
+
+	for (byte i = 0; i < sizeof(knownFrames) / sizeof(knownFrames[0]); i++)
+		for (byte e = 0; e < 3; e++)
+		{
+			char frame[32];
+			byte length = knownFrames[i].length;
+			word crc = engines[e](knownFrames[i].frame, length);
+			memcpy(frame, knownFrames[i].frame, length);
+			frame[length] = crc & 0xFF;
+			frame[length + 1] = crc >> 8;
+			if (crc != knownFrames[i].crc || engines[e](frame, length + 2) != MODBUS_CRC_RESIDUE)
+			{
+				printf("frame %d, %s: CRC 0x%04X, expected 0x%04X\n", i, engineNames[e], crc, knownFrames[i].crc);
+				failures++;
+			}
+		}
+
+	for (byte e = 0; e < 3; e++)
+	{
+		char frame[7] = "\x01\x03\x04\x44\x7A\x00\x00";
+		volatile word sink = 0;
+		clock_t start = clock();
+		for (long i = 0; i < 2000000; i++)
+		{
+			frame[3] = i;
+			sink ^= engines[e](frame, sizeof(frame));
+		}
+		double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+		printf("ModbusCrc %-7s %6.2f ns a byte\n", engineNames[e], seconds * 1e9 / (2000000.0 * sizeof(frame)));
+	}
+
+	printf("ModbusCrcTest: %s\n", failures ? "FAILED" : "all engines agree");
+	return failures != 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * ProfileTest.c
+ *
+ * Fills the profile past PROFILE_SIZE and checks every sample reads back as it was
+ * stored, that the ones that did not fit are counted, and that it empties again
+ */
+
+#include <stdio.h>
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "Profile.h"
+
+int main(void)
+{
+	int failures = 0;
+	long position;
+	long force;
+	byte status;
+
+	for (byte stroke = 0; stroke < 2; stroke++)
+	{
+		ProfileClear();
+		if (ProfileCount() != 0 || ProfileLost() != 0 || ProfileRead(0, &position, &force, &status))
+		{
+			printf("stroke %d: profile not empty after ProfileClear\n", stroke);
+			failures++;
+		}
+		for (long i = 0; i < PROFILE_SIZE + 10; i++)
+			if (ProfileAdd(i * 3 - stroke, -i * 1024 + stroke, i & 0x07) != (i < PROFILE_SIZE))
+			{
+				printf("stroke %d: ProfileAdd %ld answered wrongly\n", stroke, i);
+				failures++;
+			}
+		if (ProfileCount() != PROFILE_SIZE || ProfileLost() != 10)
+		{
+			printf("stroke %d: count %u lost %u, expected %u and 10\n", stroke, ProfileCount(), ProfileLost(), PROFILE_SIZE);
+			failures++;
+		}
+		for (word i = 0; i < PROFILE_SIZE; i++)
+			if (!ProfileRead(i, &position, &force, &status) || position != i * 3L - stroke || force != -i * 1024L + stroke || status != (i & 0x07))
+			{
+				printf("stroke %d: sample %u read back wrongly\n", stroke, i);
+				failures++;
+			}
+		if (ProfileRead(PROFILE_SIZE, &position, &force, &status))
+		{
+			printf("stroke %d: read past the end\n", stroke);
+			failures++;
+		}
+	}
+
+	printf("ProfileTest: %s\n", failures ? "FAILED" : "ok");
+	return failures != 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * VarintTest.c
+ *
+ * Round trips VarintPut through the robot's decoder over the whole long range, then
+ * codes a simulated stroke with VarintDeltaFrame, the coder RobotDeltaFrame uses, drops
+ * frames, and checks the decoder picks up again at the next key frame. Prints the bytes
+ * a sample takes.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "StandardTypes.h"
+#include "Varint.h"
+
+// Reads a value written by VarintPut from at most length bytes of in; this is what the robot does
+// to decode it. Returns the number of bytes read, or 0 if the value runs past length or is too long
+static byte VarintGet(const char* in, byte length, long* value)
+{
+	dword zigzag = 0;
+	for (byte i = 0; i < length && i < VARINT_MAX; i++)
+	{
+		zigzag |= (dword)((byte)in[i] & 0x7F) << (7 * i);
+		if (!((byte)in[i] & 0x80))
+		{
+			*value = (int32_t)((zigzag >> 1) ^ -(zigzag & 1));
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+static int RoundTrip(long value)
+{
+	char out[VARINT_MAX + 1];
+	long back;
+	byte length = VarintPut(out, value);
+	byte read = VarintGet(out, length, &back);
+	if (length > VARINT_MAX || read != length || back != value || VarintGet(out, length - 1, &back))
+	{
+		printf("%ld: %d bytes, read %d, back %ld\n", value, length, read, back);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	int failures = 0;
+
+	for (long value = -100000; value <= 100000; value++)
+		failures += RoundTrip(value);
+	for (int shift = 0; shift < 31; shift++)
+	{
+		long edge = 1L << shift;
+		failures += RoundTrip(edge - 1) + RoundTrip(edge) + RoundTrip(-edge) + RoundTrip(-edge - 1);
+	}
+	for (long value = INT32_MIN; value < INT32_MAX - 65521; value += 65521)
+		failures += RoundTrip(value);
+	failures += RoundTrip(INT32_MIN) + RoundTrip(INT32_MAX);
+
+	// A stroke of 4000 samples, 4 a frame: force rises from 0 and wobbles, position steps by 5;
+	// the decoder misses frames 7, 50 and 51 and must be back in step from the next key frame
+	char frame[DELTA_FRAME_MAX(4)];
+	byte sequence = 0;
+	long codedPosition = 0;
+	long codedForce = 0;
+	long position = 12000;
+	long force = 0;
+	long bytes = 0;
+	long samples = 0;
+	long decodedPosition = 0;
+	long decodedForce = 0;
+	byte inStep = 1;
+	for (int f = 0; f < 1000; f++)
+	{
+		long forces[4];
+		for (byte i = 0; i < 4; i++)
+		{
+			force += 37 + (((f * 4 + i) * 7919) % 61) - 30;
+			forces[i] = force;
+		}
+		byte length = VarintDeltaFrame(frame, sequence++, position, 5, forces, 4, &codedPosition, &codedForce);
+		bytes += length + 2; // and the CRC
+		samples += 4;
+		if (f == 7 || f == 50 || f == 51)
+		{
+			inStep = 0;
+			position += 20;
+			continue;
+		}
+		if (!((byte)frame[0] % DELTA_KEY_INTERVAL))
+		{
+			decodedPosition = 0;
+			decodedForce = 0;
+			inStep = 1;
+		}
+		byte index = 2;
+		for (byte i = 0; i < frame[1]; i++)
+		{
+			long delta;
+			index += VarintGet(&frame[index], length - index, &delta);
+			decodedPosition += delta;
+			index += VarintGet(&frame[index], length - index, &delta);
+			decodedForce += delta;
+			if (inStep && (decodedPosition != position + i * 5 || decodedForce != forces[i]))
+			{
+				printf("frame %d sample %d: %ld %ld, expected %ld %ld\n", f, i, decodedPosition, decodedForce, position + i * 5, forces[i]);
+				failures++;
+			}
+		}
+		if (index != length)
+		{
+			printf("frame %d: read %d of %d bytes\n", f, index, length);
+			failures++;
+		}
+		position += 20;
+	}
+	printf("dfDelta: %.2f bytes a sample\n", (double)bytes / samples);
+
+	printf("VarintTest: %s\n", failures ? "FAILED" : "ok");
+	return failures != 0;
+}
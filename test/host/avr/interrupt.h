@@ -0,0 +1,12 @@
+/*
+ * Stand-in for <avr/interrupt.h>: the host tests run in one thread, so there
+ * is nothing to mask
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#define cli()
+#define sei()
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
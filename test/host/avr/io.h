@@ -0,0 +1,14 @@
+/*
+ * Stand-in for <avr/io.h> so the modules that do not touch the hardware can be
+ * built and tested on the host. Only what those modules use is here.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+extern volatile uint8_t SREG;
+
+#endif /* HOST_AVR_IO_H_ */
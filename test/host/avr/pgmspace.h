@@ -0,0 +1,13 @@
+/*
+ * Stand-in for <avr/pgmspace.h>: on the host flash is just memory
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+#endif /* HOST_AVR_PGMSPACE_H_ */